@@ -2,11 +2,14 @@
 #define ANSI_KEYS_H
 
 #include <termios.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "./ansi_parse.h"
@@ -135,22 +138,34 @@ void parse_ansi_seq(size_t size, ansi_keys *keys) {
     ansi_state st = ansi_init();
     for (size_t i = 0; i < size; i++) {
         ansi_res res = ansi_step(&st, keys->buf[i]);
-        if (res.done) {
+        if (res.done && !res.is_query) { // replies that arrive late aren't keys
             set_ansi_key(res.key_code, res.key_event, keys);
         }
     }
 }
 
+/// Read stdin ansi sequences into a buffer and parse as keys.
+/// Blocks if there's nothing to read: call once poll() says stdin is ready.
+/// Returns what read() did: 0 at end of file, -1 on an error (see errno;
+/// EAGAIN is worth trying again later, an interrupted read is retried).
+ssize_t read_ansi_keys(ansi_keys *keys) {
+    memset(keys->buf, 0, keys->buf_size); // clear buffer
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, keys->buf, keys->buf_size); // read bytes
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return n;
+    parse_ansi_seq(n, keys); // parse it
+    return n;
+}
+
 /// Update key state from stdin ansi sequences, into a buffer and parse as keys
 size_t update_ansi_keys(ansi_keys *keys) {
     if (!kbhit()) {
         return 0; // No key pressed
     }
-
-    memset(keys->buf, 0, keys->buf_size); // clear buffer
-    size_t n = read(STDIN_FILENO, keys->buf, keys->buf_size); // read bytes
-    parse_ansi_seq(n, keys); // parse it
-    return n;
+    ssize_t n = read_ansi_keys(keys);
+    return n > 0 ? n : 0;
 }
 
 bool check_ansi_keys_enabled(ansi_keys *keys) {
@@ -172,4 +187,35 @@ bool check_ansi_keys_enabled(ansi_keys *keys) {
     return false;
 }
 
+/// DECRQM: ask the terminal if it knows a private mode (eg. 69 = left/right margins)
+/// Waits up to 200ms for the reply: over ssh or tmux it can take a while,
+/// and one that turns up later is skipped by parse_ansi_seq instead.
+bool check_ansi_mode(int mode, ansi_keys *keys) {
+    printf("\e[?%d$p", mode);
+    fflush(stdout);
+
+    struct timespec now, end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long end_ms = end.tv_sec * 1000 + end.tv_nsec / 1000000 + 200;
+    ansi_state st = ansi_init();
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long left = end_ms - (now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+        if (left <= 0 || poll(&pfd, 1, (int)left) == 0) {
+            return false; // No response
+        }
+        ssize_t n = read(STDIN_FILENO, keys->buf, keys->buf_size);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) return false;
+        // Reply is "\e[?{mode};{val}$y", val 0 = not recognised, 4 = permanently off
+        for (ssize_t i = 0; i < n; i++) {
+            ansi_res res = ansi_step(&st, keys->buf[i]);
+            if (res.done && res.is_mode && res.key_code == mode) {
+                return res.key_event >= 1 && res.key_event <= 3;
+            }
+        }
+    }
+}
+
 #endif // ANSI_KEYS_H
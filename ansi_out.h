@@ -0,0 +1,342 @@
+#ifndef ANSI_OUT_H
+#define ANSI_OUT_H
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_BUF_SIZE (64 * 1024)
+
+// Precomputed "\e[38;5;Nm" / "\e[48;5;Nm" for every colour
+typedef struct {
+    char bytes[12];
+    uint8_t len;
+} sgr_seq;
+
+sgr_seq sgr_fg[256];
+sgr_seq sgr_bg[256];
+
+#define HALF_BLOCK "\xe2\x96\x80"  // Upper Half Block "▀" (U+2580) as UTF-8
+#define LOWER_BLOCK "\xe2\x96\x84" // Lower Half Block "▄" (U+2584)
+#define FULL_BLOCK "\xe2\x96\x88"  // Full Block "█" (U+2588)
+
+#define SGR_UNKNOWN -1
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int16_t fg; // colours the terminal will be using once `buf` is written
+    int16_t bg;
+} ansi_out;
+
+void init_sgr_tables() {
+    for (int i = 0; i < 256; i++) {
+        sgr_fg[i].len = snprintf(sgr_fg[i].bytes, sizeof(sgr_fg[i].bytes), "\e[38;5;%dm", i);
+        sgr_bg[i].len = snprintf(sgr_bg[i].bytes, sizeof(sgr_bg[i].bytes), "\e[48;5;%dm", i);
+    }
+}
+
+// Glyph for each 2x3 sextant pattern. Bit 0 is top-left, 1 top-right,
+// 2 middle-left ... 5 bottom-right; set bits are drawn in the fg colour.
+typedef struct {
+    char bytes[4];
+    uint8_t len;
+} glyph;
+
+glyph sextant_glyphs[64];
+
+uint8_t utf8_encode(uint32_t cp, char *bytes) {
+    if (cp < 0x80) {
+        bytes[0] = cp;
+        return 1;
+    }
+    if (cp < 0x10000) {
+        bytes[0] = 0xe0 | (cp >> 12);
+        bytes[1] = 0x80 | ((cp >> 6) & 0x3f);
+        bytes[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    bytes[0] = 0xf0 | (cp >> 18);
+    bytes[1] = 0x80 | ((cp >> 12) & 0x3f);
+    bytes[2] = 0x80 | ((cp >> 6) & 0x3f);
+    bytes[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
+
+void init_sextant_glyphs() {
+    for (uint8_t m = 0; m < 64; m++) {
+        uint32_t cp;
+        if (m == 0) cp = ' ';
+        else if (m == 63) cp = 0x2588; // █
+        else if (m == 21) cp = 0x258c; // ▌ (left column)
+        else if (m == 42) cp = 0x2590; // ▐ (right column)
+        else cp = 0x1fb00 + (m - 1) - (m > 21) - (m > 42); // Unicode 13 sextants
+        sextant_glyphs[m].len = utf8_encode(cp, sextant_glyphs[m].bytes);
+    }
+}
+
+ansi_out *make_ansi_out(size_t cap) {
+    ansi_out *o = (ansi_out*) malloc(sizeof(ansi_out));
+    o->cap = cap;
+    o->len = 0;
+    o->buf = (char *) malloc(sizeof(char) * o->cap);
+    o->fg = SGR_UNKNOWN;
+    o->bg = SGR_UNKNOWN;
+    init_sgr_tables();
+    init_sextant_glyphs();
+    return o;
+}
+
+void free_ansi_out(ansi_out *o) {
+    if (o != NULL) {
+        free(o->buf);
+        free(o);
+    }
+}
+
+void out_reserve(ansi_out *o, size_t n) {
+    if (o->len + n <= o->cap) return;
+    while (o->len + n > o->cap) o->cap *= 2;
+    o->buf = (char *) realloc(o->buf, o->cap);
+}
+
+void out_bytes(ansi_out *o, const char *bytes, size_t n) {
+    out_reserve(o, n);
+    memcpy(o->buf + o->len, bytes, n);
+    o->len += n;
+}
+
+void out_str(ansi_out *o, const char *str) {
+    out_bytes(o, str, strlen(str));
+}
+
+void out_char(ansi_out *o, char c) {
+    out_reserve(o, 1);
+    o->buf[o->len++] = c;
+}
+
+// Decimal without going through stdio
+void out_uint(ansi_out *o, uint32_t n) {
+    char tmp[10];
+    uint8_t i = 0;
+    do {
+        tmp[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0);
+    out_reserve(o, i);
+    while (i > 0) o->buf[o->len++] = tmp[--i];
+}
+
+void out_esc(ansi_out *o, const char *str) {
+    out_bytes(o, "\e[", 2);
+    out_str(o, str);
+}
+
+void out_cursor_to(ansi_out *o, uint16_t x, uint16_t y) {
+    out_bytes(o, "\e[", 2);
+    out_uint(o, y);
+    out_char(o, ';');
+    out_uint(o, x);
+    out_char(o, 'H');
+}
+
+void out_cursor_fwd(ansi_out *o, uint16_t n) {
+    out_bytes(o, "\e[", 2);
+    out_uint(o, n);
+    out_char(o, 'C');
+}
+
+// Forget the terminal colours (after an "\e[0m" or anything not sent via `o`)
+void out_sgr_reset(ansi_out *o) {
+    o->fg = SGR_UNKNOWN;
+    o->bg = SGR_UNKNOWN;
+}
+
+void out_fg(ansi_out *o, uint8_t col) {
+    if (o->fg == col) return;
+    out_bytes(o, sgr_fg[col].bytes, sgr_fg[col].len);
+    o->fg = col;
+}
+
+void out_bg(ansi_out *o, uint8_t col) {
+    if (o->bg == col) return;
+    out_bytes(o, sgr_bg[col].bytes, sgr_bg[col].len);
+    o->bg = col;
+}
+
+/// Bytes needed to get the terminal to fg/bg (SGR_UNKNOWN = don't care)
+uint8_t sgr_cost(ansi_out *o, int16_t fg, int16_t bg) {
+    bool set_fg = fg != SGR_UNKNOWN && fg != o->fg;
+    bool set_bg = bg != SGR_UNKNOWN && bg != o->bg;
+    if (set_fg && set_bg) {
+        return sgr_fg[fg].len + sgr_bg[bg].len - 2; // merged into one sequence
+    }
+    if (set_fg) return sgr_fg[fg].len;
+    if (set_bg) return sgr_bg[bg].len;
+    return 0;
+}
+
+/// Set fg and bg, merging them into one "\e[38;5;N;48;5;Mm" if both change
+void out_sgr(ansi_out *o, int16_t fg, int16_t bg) {
+    bool set_fg = fg != SGR_UNKNOWN && fg != o->fg;
+    bool set_bg = bg != SGR_UNKNOWN && bg != o->bg;
+    if (set_fg && set_bg) {
+        out_bytes(o, sgr_fg[fg].bytes, sgr_fg[fg].len - 1);
+        out_char(o, ';');
+        out_bytes(o, sgr_bg[bg].bytes + 2, sgr_bg[bg].len - 2);
+        o->fg = fg;
+        o->bg = bg;
+    } else if (set_fg) {
+        out_fg(o, fg);
+    } else if (set_bg) {
+        out_bg(o, bg);
+    }
+}
+
+void out_half_block(ansi_out *o) {
+    out_bytes(o, HALF_BLOCK, sizeof(HALF_BLOCK) - 1);
+}
+
+/// One character cell showing two stacked pixels. Picks whichever of
+/// " ", "▀", "▄" and "█" needs the fewest bytes given the current colours,
+/// so runs of one colour become a single SGR and then plain glyphs.
+void out_cell(ansi_out *o, uint8_t top, uint8_t bottom) {
+    if (top == bottom) {
+        // space shows the bg, full block shows the fg (and is 2 bytes longer)
+        if (sgr_cost(o, SGR_UNKNOWN, top) <= sgr_cost(o, top, SGR_UNKNOWN) + 2) {
+            out_sgr(o, SGR_UNKNOWN, top);
+            out_char(o, ' ');
+        } else {
+            out_sgr(o, top, SGR_UNKNOWN);
+            out_bytes(o, FULL_BLOCK, sizeof(FULL_BLOCK) - 1);
+        }
+        return;
+    }
+
+    if (sgr_cost(o, top, bottom) <= sgr_cost(o, bottom, top)) {
+        out_sgr(o, top, bottom);
+        out_bytes(o, HALF_BLOCK, sizeof(HALF_BLOCK) - 1);
+    } else {
+        out_sgr(o, bottom, top);
+        out_bytes(o, LOWER_BLOCK, sizeof(LOWER_BLOCK) - 1);
+    }
+}
+
+// Only for text that isn't per-cell (status line etc.)
+void out_printf(ansi_out *o, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (n <= 0) return;
+
+    out_reserve(o, n + 1);
+    va_start(args, fmt);
+    vsnprintf(o->buf + o->len, n + 1, fmt, args);
+    va_end(args);
+    o->len += n;
+}
+
+/// One character cell showing 2x3 pixels (row-major in `px`). Keeps the two
+/// most common colours and draws the pattern or its inverse, whichever
+/// needs fewer colour bytes.
+void out_sextant(ansi_out *o, const uint8_t px[6]) {
+    uint8_t a = px[0], na = 0;
+    uint8_t b = px[0], nb = 0;
+    for (uint8_t k = 0; k < 6; k++) {
+        uint8_t n = 0;
+        for (uint8_t l = 0; l < 6; l++) n += px[l] == px[k];
+        if (n > na) {
+            a = px[k];
+            na = n;
+        }
+    }
+    for (uint8_t k = 0; k < 6; k++) {
+        if (px[k] == a) continue;
+        uint8_t n = 0;
+        for (uint8_t l = 0; l < 6; l++) n += px[l] == px[k];
+        if (n > nb) {
+            b = px[k];
+            nb = n;
+        }
+    }
+
+    uint8_t mask = 0;
+    for (uint8_t k = 0; k < 6; k++) {
+        if (px[k] == a) mask |= 1 << k;
+    }
+    if (mask == 63) {
+        out_cell(o, a, a);
+        return;
+    }
+
+    uint8_t inv = ~mask & 63;
+    uint16_t cost = sgr_cost(o, a, b) + sextant_glyphs[mask].len;
+    uint16_t cost_inv = sgr_cost(o, b, a) + sextant_glyphs[inv].len;
+    if (cost <= cost_inv) {
+        out_sgr(o, a, b);
+    } else {
+        out_sgr(o, b, a);
+        mask = inv;
+    }
+    out_bytes(o, sextant_glyphs[mask].bytes, sextant_glyphs[mask].len);
+}
+
+/// Scroll the rectangle (1-based, inclusive) by dx columns / dy rows using
+/// DECSTBM + DECSLRM margins. Positive moves content left / up. Only for
+/// terminals that support left/right margins (DEC mode 69).
+void out_scroll_rect(ansi_out *o,
+                     uint16_t left, uint16_t top, uint16_t right, uint16_t bottom,
+                     int16_t dx, int16_t dy) {
+    out_esc(o, "?69h"); // DECLRMM: allow left/right margins
+    out_bytes(o, "\e[", 2);
+    out_uint(o, top);
+    out_char(o, ';');
+    out_uint(o, bottom);
+    out_char(o, 'r');   // DECSTBM
+    out_bytes(o, "\e[", 2);
+    out_uint(o, left);
+    out_char(o, ';');
+    out_uint(o, right);
+    out_char(o, 's');   // DECSLRM
+    if (dy != 0) {
+        out_bytes(o, "\e[", 2);
+        out_uint(o, dy > 0 ? dy : -dy);
+        out_char(o, dy > 0 ? 'S' : 'T'); // SU / SD
+    }
+    if (dx != 0) {
+        out_bytes(o, "\e[", 2);
+        out_uint(o, dx > 0 ? dx : -dx);
+        out_str(o, dx > 0 ? " @" : " A"); // SL / SR
+    }
+    out_esc(o, "s");    // full width margins again
+    out_esc(o, "r");    // full height
+    out_esc(o, "?69l");
+}
+
+/// Write the whole buffer to `fd` (normally one write) and empty it.
+/// Returns the number of bytes written.
+size_t out_flush(ansi_out *o, int fd) {
+    size_t done = 0;
+    while (done < o->len) {
+        ssize_t n = write(fd, o->buf + done, o->len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Anything else, a full non-blocking fd included, loses the
+            // rest of the frame rather than spin or wait on the tty
+            out_sgr_reset(o); // don't know what made it out
+            break;
+        }
+        done += n;
+    }
+    o->len = 0;
+    return done;
+}
+
+#endif // ANSI_OUT_H
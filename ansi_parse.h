@@ -13,7 +13,8 @@ typedef struct {
         ANSI_BYTE,
         ANSI_MODIFIER,
         ANSI_EVENT,
-        ANSI_QUERY
+        ANSI_QUERY,
+        ANSI_MODE
     } state;
     int key_code;
     int key_modifier;
@@ -23,6 +24,7 @@ typedef struct {
 typedef struct {
     bool done;
     bool is_query;
+    bool is_mode; // DECRPM reply: key_code = mode, key_event = its value
     int key_code;
     int modifier;
     int key_event;
@@ -39,7 +41,8 @@ void ansi_done(ansi_state *state, ansi_res *res) {
     res->key_code = state->key_code;
     res->modifier = state->key_modifier;
     res->key_event = state->key_event;
-    res->is_query = state->state == ANSI_QUERY;
+    res->is_query = state->state == ANSI_QUERY || state->state == ANSI_MODE;
+    res->is_mode = state->state == ANSI_MODE;
 
     state->key_code = 0;
     state->key_modifier = 0;
@@ -124,11 +127,25 @@ ansi_res ansi_step(ansi_state *state, char c) {
             state->key_code = (state->key_code * 10) + num;
         } else if (c == 'u') {
             ansi_done(state, &r);
+        } else if (c == ';') {
+            // mode reply "\e[?{mode};{val}$y"
+            state->key_event = 0;
+            state->state = ANSI_MODE;
         } else {
             // err
         }
         break;
 
+    case ANSI_MODE:
+        if (isdigit(c)) {
+            state->key_event = (state->key_event * 10) + (c - '0');
+        } else if (c == 'y') {
+            ansi_done(state, &r);
+        } else if (c != '$') {
+            state->state = ANSI_ESC; // not a mode reply: drop it
+        }
+        break;
+
     default:
         break;
     }
@@ -0,0 +1,166 @@
+// Simulation benchmark: ticks the world with no terminal and prints one JSON
+// object per run, so results can be diffed and tracked between versions.
+//
+//   ./bench [-t ticks] [-j threads] [-s size]
+#define TERRY_NO_MAIN
+#include "terry.c"
+
+#include <glob.h>
+
+#define BENCH_TICKS 1000
+#define BENCH_SIZE 256 // stress maps are this many tiles square
+
+int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// Tiles on the worklist right now: what a tick will actually look at
+uint64_t count_active() {
+    uint64_t n = 0;
+    for (int32_t y = 0; y < world_state.h; y++) {
+        n += world_state.row_awake[y];
+    }
+    return n;
+}
+
+/// Tick the current world `ticks` times and report on it
+void run(const char *name, uint64_t world_seed, player_state *s, uint32_t ticks) {
+    uint64_t *lat = malloc(ticks * sizeof(uint64_t));
+    uint64_t active = 0;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < ticks; i++) {
+        active += count_active();
+        uint64_t t0 = now_ns();
+        s->t++;
+        tick_tiles(s);
+        lat[i] = now_ns() - t0;
+        total += lat[i];
+    }
+    qsort(lat, ticks, sizeof(uint64_t), cmp_u64);
+
+    double tiles = (double)world_state.w * world_state.h * ticks;
+    printf("{\"bench\": \"%s\", \"seed\": %" PRIu64 ", \"w\": %d, \"h\": %d, "
+           "\"threads\": %d, \"ticks\": %u, \"ticks_per_s\": %.1f, "
+           "\"ns_per_tile\": %.3f, \"ns_per_active_tile\": %.3f, "
+           "\"active_per_tick\": %.1f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+           "\"hash\": \"%016" PRIx64 "\"}\n",
+           name, world_seed, world_state.w, world_state.h,
+           pool.threads, ticks, ticks * (double)NS_PER_SEC / max(total, 1),
+           total / tiles, active ? total / (double)active : 0.0,
+           active / (double)ticks,
+           lat[ticks / 2] / 1e3, lat[(uint64_t)ticks * 99 / 100] / 1e3,
+           world_hash(s));
+    fflush(stdout);
+    free(lat);
+}
+
+bool bench_world(int32_t w, int32_t h, uint64_t world_seed, player_state *s) {
+    *s = (player_state){ .x = 2, .y = 2, .lives = 16 };
+    if (!init_world(w, h, world_seed)) {
+        fprintf(stderr, "Can't make a %dx%d world\n", w, h);
+        return false;
+    }
+    return true;
+}
+
+// Stress maps: each one keeps a different part of the simulation busy
+
+/// Rocks over three quarters of the world, nothing under them
+void rocks_map(int32_t w, int32_t h) {
+    for (int32_t y = 0; y < h * 3 / 4; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            set_tile(x, y, TILE_ROCK);
+        }
+    }
+}
+
+/// Fireflies in open space, one every third tile
+void fireflies_map(int32_t w, int32_t h) {
+    for (int32_t y = 0; y < h; y += 3) {
+        for (int32_t x = (y / 3) % 3; x < w; x += 3) {
+            set_tile_and_data_dir(x, y, TILE_FIREFLY, (dir){1,0});
+        }
+    }
+}
+
+/// Lasers down both sides, every other row, with columns of rock falling
+/// through their beams
+void lasers_map(int32_t w, int32_t h) {
+    for (int32_t y = 0; y < h; y += 2) {
+        set_tile_and_data_dir(0, y, TILE_LASER, (dir){1,0});
+        set_tile_and_data_dir(w - 1, y + 1, TILE_LASER, (dir){-1,0});
+    }
+    for (int32_t x = 4; x < w - 1; x += 8) {
+        for (int32_t y = 0; y < h / 2; y++) {
+            set_tile(x, y, TILE_ROCK);
+        }
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*fill)(int32_t w, int32_t h);
+} stress_map;
+
+stress_map stress_maps[] = {
+    { "rocks", rocks_map },
+    { "fireflies", fireflies_map },
+    { "lasers", lasers_map },
+};
+
+int main(int argc, char **argv) {
+    uint32_t ticks = BENCH_TICKS;
+    int32_t size = BENCH_SIZE;
+    int threads = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:j:s:h")) != -1) {
+        switch (opt) {
+        case 't': ticks = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 's': size = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-t ticks] [-j threads] [-s size]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (ticks < 1 || size < 3 || threads < 0) {
+        fprintf(stderr, "usage: %s [-t ticks] [-j threads] [-s size]\n", argv[0]);
+        return 1;
+    }
+    if (threads > 0) {
+        start_tick_pool(threads);
+    }
+    player_state s;
+
+    // Random levels at the default size and at the stress size
+    for (uint64_t sd = 1; sd <= 3; sd++) {
+        if (!bench_world(DEFAULT_WORLD_W, DEFAULT_WORLD_H, sd, &s)) return 1;
+        random_level(s.x, s.y);
+        run("random", sd, &s, ticks);
+    }
+    if (!bench_world(size, size, 1, &s)) return 1;
+    random_level(s.x, s.y);
+    run("random", 1, &s, ticks);
+
+    glob_t levels;
+    if (glob("data/level/simplified/*/tiles.csv", 0, NULL, &levels) == 0) {
+        for (size_t i = 0; i < levels.gl_pathc; i++) {
+            s = (player_state){ .x = 2, .y = 2, .lives = 16 };
+            if (!load_level(levels.gl_pathv[i], &s)) continue;
+            run(levels.gl_pathv[i], world_state.seed, &s, ticks);
+        }
+        globfree(&levels);
+    }
+
+    for (size_t i = 0; i < sizeof(stress_maps) / sizeof(stress_maps[0]); i++) {
+        if (!bench_world(size, size, 1, &s)) return 1;
+        stress_maps[i].fill(size, size);
+        run(stress_maps[i].name, 1, &s, ticks);
+    }
+
+    stop_tick_pool();
+    return 0;
+}
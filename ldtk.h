@@ -0,0 +1,491 @@
+#ifndef LDTK_H
+#define LDTK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Importing LDtk projects (ldtk.io) in one streaming pass: a push parser
+// turns the JSON into events as bytes arrive, and the LDtk part picks the
+// levels, IntGrid cells and entities out of those. Nothing is kept but the
+// current path through the document, so memory is the same few KB however
+// many levels there are.
+
+// ============= JSON ==================
+
+#define JSON_MAX_DEPTH 32
+#define JSON_MAX_STR 256 // longer strings are cut short
+#define JSON_KEY_LEN 32
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING
+} json_kind;
+
+// One open object or array
+typedef struct {
+    bool array;
+    int32_t index;            // of the current value, in an array
+    char key[JSON_KEY_LEN];   // of the current value, in an object
+} json_frame;
+
+typedef enum {
+    JS_VALUE,   // a value is next
+    JS_AFTER,   // after a value: ',' or the end of the container
+    JS_KEY,     // a key is next (or '}')
+    JS_COLON,
+    JS_STRING,
+    JS_ESCAPE,
+    JS_UNICODE,
+    JS_NUMBER,
+    JS_LITERAL, // true, false or null
+    JS_DONE,
+    JS_ERROR
+} json_state;
+
+typedef struct json_parser json_parser;
+
+struct json_parser {
+    json_frame stack[JSON_MAX_DEPTH];
+    int depth;      // open containers
+    json_state state;
+    bool in_key;    // the string being read is a key
+    char buf[JSON_MAX_STR];
+    size_t len;
+    uint8_t hex;    // \u digits still to skip
+    // A scalar value; `depth` and the top frame say where it is
+    void (*value)(json_parser *p, json_kind kind, const char *str, double num);
+    // After an object or array has been opened (it's the top frame), and
+    // just before it's closed
+    void (*begin)(json_parser *p);
+    void (*end)(json_parser *p);
+    void *ctx;
+};
+
+void json_init(json_parser *p, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->state = JS_VALUE;
+    p->ctx = ctx;
+}
+
+json_frame *json_top(json_parser *p) {
+    return p->depth > 0 ? &p->stack[p->depth - 1] : NULL;
+}
+
+/// The key of the value at `level` (0: in the root object), or "" in an array
+const char *json_key(json_parser *p, int level) {
+    if (level >= p->depth || p->stack[level].array) return "";
+    return p->stack[level].key;
+}
+
+void json_emit(json_parser *p, json_kind kind, double num) {
+    p->buf[p->len] = '\0';
+    if (p->value) p->value(p, kind, p->buf, num);
+    p->state = p->depth == 0 ? JS_DONE : JS_AFTER;
+}
+
+void json_push(json_parser *p, bool array) {
+    if (p->depth == JSON_MAX_DEPTH) {
+        p->state = JS_ERROR;
+        return;
+    }
+    p->stack[p->depth++] = (json_frame){ .array = array };
+    if (p->begin) p->begin(p);
+    p->state = array ? JS_VALUE : JS_KEY;
+}
+
+void json_pop(json_parser *p, bool array) {
+    json_frame *f = json_top(p);
+    if (f == NULL || f->array != array) {
+        p->state = JS_ERROR;
+        return;
+    }
+    if (p->end) p->end(p);
+    p->depth--;
+    p->state = p->depth == 0 ? JS_DONE : JS_AFTER;
+}
+
+bool json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/// Take the next bytes of the document. Returns false once it's found to
+/// be broken.
+bool json_feed(json_parser *p, const char *bytes, size_t n) {
+    for (size_t i = 0; i < n && p->state != JS_ERROR; i++) {
+        char c = bytes[i];
+        switch (p->state) {
+        case JS_VALUE:
+            if (json_space(c)) break;
+            p->len = 0;
+            if (c == '{') {
+                json_push(p, false);
+            } else if (c == '[') {
+                json_push(p, true);
+            } else if (c == ']' && json_top(p) && json_top(p)->array && json_top(p)->index == 0) {
+                json_pop(p, true); // empty array
+            } else if (c == '"') {
+                p->in_key = false;
+                p->state = JS_STRING;
+            } else if (c == '-' || (c >= '0' && c <= '9')) {
+                p->buf[p->len++] = c;
+                p->state = JS_NUMBER;
+            } else if (c == 't' || c == 'f' || c == 'n') {
+                p->buf[p->len++] = c;
+                p->state = JS_LITERAL;
+            } else {
+                p->state = JS_ERROR;
+            }
+            break;
+        case JS_AFTER:
+            if (json_space(c)) break;
+            if (c == ',') {
+                json_frame *f = json_top(p);
+                if (f->array) {
+                    f->index++;
+                    p->state = JS_VALUE;
+                } else {
+                    p->state = JS_KEY;
+                }
+            } else if (c == ']' || c == '}') {
+                json_pop(p, c == ']');
+            } else {
+                p->state = JS_ERROR;
+            }
+            break;
+        case JS_KEY:
+            if (json_space(c)) break;
+            if (c == '"') {
+                p->len = 0;
+                p->in_key = true;
+                p->state = JS_STRING;
+            } else if (c == '}') {
+                json_pop(p, false);
+            } else {
+                p->state = JS_ERROR;
+            }
+            break;
+        case JS_COLON:
+            if (json_space(c)) break;
+            p->state = c == ':' ? JS_VALUE : JS_ERROR;
+            break;
+        case JS_STRING:
+            if (c == '\\') {
+                p->state = JS_ESCAPE;
+            } else if (c == '"') {
+                p->buf[p->len] = '\0';
+                if (p->in_key) {
+                    size_t n = p->len < JSON_KEY_LEN - 1 ? p->len : JSON_KEY_LEN - 1;
+                    memcpy(json_top(p)->key, p->buf, n);
+                    json_top(p)->key[n] = '\0';
+                    p->state = JS_COLON;
+                } else {
+                    json_emit(p, JSON_STRING, 0);
+                }
+            } else if (p->len < JSON_MAX_STR - 1) {
+                p->buf[p->len++] = c;
+            }
+            break;
+        case JS_ESCAPE:
+            if (c == 'u') {
+                // Nothing LDtk needs from us is outside ASCII
+                p->hex = 4;
+                c = '?';
+                p->state = JS_UNICODE;
+            } else {
+                c = c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' :
+                    c == 'b' ? '\b' : c == 'f' ? '\f' : c;
+                p->state = JS_STRING;
+            }
+            if (p->len < JSON_MAX_STR - 1) p->buf[p->len++] = c;
+            break;
+        case JS_UNICODE:
+            if (--p->hex == 0) p->state = JS_STRING;
+            break;
+        case JS_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+                c == '+' || c == '-') {
+                if (p->len < JSON_MAX_STR - 1) p->buf[p->len++] = c;
+                break;
+            }
+            p->buf[p->len] = '\0';
+            json_emit(p, JSON_NUMBER, strtod(p->buf, NULL));
+            i--; // that wasn't part of it: look again
+            break;
+        case JS_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                if (p->len < JSON_MAX_STR - 1) p->buf[p->len++] = c;
+                break;
+            }
+            p->buf[p->len] = '\0';
+            if (strcmp(p->buf, "true") == 0 || strcmp(p->buf, "false") == 0) {
+                json_emit(p, JSON_BOOL, p->buf[0] == 't');
+            } else if (strcmp(p->buf, "null") == 0) {
+                json_emit(p, JSON_NULL, 0);
+            } else {
+                p->state = JS_ERROR;
+                break;
+            }
+            i--;
+            break;
+        case JS_DONE:
+            if (!json_space(c)) p->state = JS_ERROR;
+            break;
+        case JS_ERROR:
+            break;
+        }
+    }
+    return p->state != JS_ERROR;
+}
+
+/// At the end of the document: was it all there?
+bool json_finish(json_parser *p) {
+    // A number or literal at the very end has nothing after it to end it
+    if (p->state == JS_NUMBER || p->state == JS_LITERAL) json_feed(p, " ", 1);
+    return p->state == JS_DONE;
+}
+
+// ============= LDtk ==================
+
+#define LDTK_NAME_LEN 64
+#define LDTK_PATH_LEN 256
+
+typedef struct {
+    char identifier[LDTK_NAME_LEN];
+    int32_t world_x; // in pixels
+    int32_t world_y;
+    int32_t px_w;
+    int32_t px_h;
+    int32_t grid_size; // of its first IntGrid layer, 0 if none
+    char external[LDTK_PATH_LEN]; // externalRelPath, if it's saved separately
+} ldtk_level;
+
+typedef struct {
+    char identifier[LDTK_NAME_LEN];
+    char type[16]; // "IntGrid", "Entities", ...
+    int32_t c_w;   // in cells
+    int32_t c_h;
+    int32_t grid_size;
+} ldtk_layer;
+
+typedef struct {
+    char identifier[LDTK_NAME_LEN];
+    int32_t grid_x; // cell, in its layer
+    int32_t grid_y;
+    int32_t px_x;   // pixels, in its level
+    int32_t px_y;
+    int32_t w;
+    int32_t h;
+} ldtk_entity;
+
+// What an import reports. Any of these can be NULL.
+typedef struct {
+    void *ctx;
+    // Once per level, when it's all been read
+    void (*level)(void *ctx, const ldtk_level *l);
+    // Every IntGrid cell that isn't 0, as it's read. Its level's world
+    // position is known by then (LDtk writes it before the layers), but not
+    // necessarily the rest of the level.
+    void (*cell)(void *ctx, const ldtk_level *l, const ldtk_layer *layer,
+                 int32_t x, int32_t y, int32_t value);
+    void (*entity)(void *ctx, const ldtk_level *l, const ldtk_layer *layer,
+                   const ldtk_entity *e);
+} ldtk_callbacks;
+
+typedef struct {
+    ldtk_callbacks *cb;
+    const char *dir;  // external levels are relative to this
+    int base;         // depth of a level object's fields: 2 in a project, 0 in a level file
+    ldtk_level level;
+    ldtk_layer layer;
+    ldtk_entity entity;
+    bool ok;
+} ldtk_import;
+
+bool ldtk_import_file(const char *path, ldtk_callbacks *cb);
+bool ldtk_parse_file(const char *path, const char *dir, int base, ldtk_callbacks *cb);
+
+void ldtk_name(char *dst, size_t size, json_kind kind, const char *str) {
+    snprintf(dst, size, "%s", kind == JSON_STRING ? str : "");
+}
+
+void ldtk_value(json_parser *p, json_kind kind, const char *str, double num) {
+    ldtk_import *im = p->ctx;
+    int b = im->base;
+    if (b == 2 && (p->depth < 2 || strcmp(json_key(p, 0), "levels") != 0)) return;
+
+    const char *k = json_key(p, b);
+    if (p->depth == b + 1) {
+        ldtk_level *l = &im->level;
+        if (strcmp(k, "identifier") == 0) ldtk_name(l->identifier, LDTK_NAME_LEN, kind, str);
+        else if (strcmp(k, "worldX") == 0) l->world_x = num;
+        else if (strcmp(k, "worldY") == 0) l->world_y = num;
+        else if (strcmp(k, "pxWid") == 0) l->px_w = num;
+        else if (strcmp(k, "pxHei") == 0) l->px_h = num;
+        else if (strcmp(k, "externalRelPath") == 0) ldtk_name(l->external, LDTK_PATH_LEN, kind, str);
+        return;
+    }
+    if (strcmp(k, "layerInstances") != 0) return;
+
+    const char *lk = json_key(p, b + 2);
+    if (p->depth == b + 3) {
+        ldtk_layer *layer = &im->layer;
+        if (strcmp(lk, "__identifier") == 0) ldtk_name(layer->identifier, LDTK_NAME_LEN, kind, str);
+        else if (strcmp(lk, "__type") == 0) ldtk_name(layer->type, sizeof(layer->type), kind, str);
+        else if (strcmp(lk, "__cWid") == 0) layer->c_w = num;
+        else if (strcmp(lk, "__cHei") == 0) layer->c_h = num;
+        else if (strcmp(lk, "__gridSize") == 0) layer->grid_size = num;
+        return;
+    }
+    if (p->depth == b + 4 && strcmp(lk, "intGridCsv") == 0) {
+        int32_t i = p->stack[b + 3].index;
+        if (num != 0 && im->layer.c_w > 0 && im->cb->cell) {
+            im->cb->cell(im->cb->ctx, &im->level, &im->layer,
+                         i % im->layer.c_w, i / im->layer.c_w, num);
+        }
+        return;
+    }
+    if (strcmp(lk, "entityInstances") != 0 || p->depth < b + 5) return;
+
+    ldtk_entity *e = &im->entity;
+    const char *ek = json_key(p, b + 4);
+    if (p->depth == b + 5) {
+        if (strcmp(ek, "__identifier") == 0) ldtk_name(e->identifier, LDTK_NAME_LEN, kind, str);
+        else if (strcmp(ek, "width") == 0) e->w = num;
+        else if (strcmp(ek, "height") == 0) e->h = num;
+    } else if (p->depth == b + 6) {
+        int32_t i = p->stack[b + 5].index;
+        if (strcmp(ek, "__grid") == 0) *(i == 0 ? &e->grid_x : &e->grid_y) = num;
+        else if (strcmp(ek, "px") == 0) *(i == 0 ? &e->px_x : &e->px_y) = num;
+    }
+}
+
+void ldtk_begin(json_parser *p) {
+    ldtk_import *im = p->ctx;
+    int b = im->base;
+    bool in_levels = b == 0 || strcmp(json_key(p, 0), "levels") == 0;
+    if (!in_levels || p->stack[p->depth - 1].array) return;
+    if (p->depth == b + 1) {
+        im->level = (ldtk_level){0};
+    } else if (p->depth == b + 3 && strcmp(json_key(p, b), "layerInstances") == 0) {
+        im->layer = (ldtk_layer){0};
+    } else if (p->depth == b + 5 && strcmp(json_key(p, b), "layerInstances") == 0 &&
+               strcmp(json_key(p, b + 2), "entityInstances") == 0) {
+        im->entity = (ldtk_entity){0};
+    }
+}
+
+void ldtk_end(json_parser *p) {
+    ldtk_import *im = p->ctx;
+    int b = im->base;
+    bool in_levels = b == 0 || strcmp(json_key(p, 0), "levels") == 0;
+    if (!in_levels || p->stack[p->depth - 1].array) return;
+    if (p->depth == b + 1) {
+        ldtk_level *l = &im->level;
+        if (b == 2 && l->external[0] != '\0') {
+            // Saved on its own: it'll be reported from there
+            char path[2 * LDTK_PATH_LEN];
+            snprintf(path, sizeof(path), "%s%s", im->dir, l->external);
+            if (!ldtk_parse_file(path, im->dir, 0, im->cb)) im->ok = false;
+        } else if (im->cb->level) {
+            im->cb->level(im->cb->ctx, l);
+        }
+    } else if (p->depth == b + 3 && strcmp(json_key(p, b), "layerInstances") == 0) {
+        if (im->level.grid_size == 0 && strcmp(im->layer.type, "IntGrid") == 0) {
+            im->level.grid_size = im->layer.grid_size;
+        }
+    } else if (p->depth == b + 5 && strcmp(json_key(p, b), "layerInstances") == 0 &&
+               strcmp(json_key(p, b + 2), "entityInstances") == 0 && im->cb->entity) {
+        im->cb->entity(im->cb->ctx, &im->level, &im->layer, &im->entity);
+    }
+}
+
+void ldtk_start(ldtk_import *im, json_parser *p, const char *dir, int base, ldtk_callbacks *cb) {
+    *im = (ldtk_import){ .cb = cb, .dir = dir, .base = base, .ok = true };
+    json_init(p, im);
+    p->value = ldtk_value;
+    p->begin = ldtk_begin;
+    p->end = ldtk_end;
+}
+
+/// Import a project (or one level file, with `base` 0) already in memory
+bool ldtk_parse_bytes(const char *bytes, size_t len, const char *dir, int base,
+                      ldtk_callbacks *cb) {
+    ldtk_import im;
+    json_parser p;
+    ldtk_start(&im, &p, dir, base, cb);
+    return json_feed(&p, bytes, len) && json_finish(&p) && im.ok;
+}
+
+bool ldtk_parse_file(const char *path, const char *dir, int base, ldtk_callbacks *cb) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return false;
+    ldtk_import im;
+    json_parser p;
+    ldtk_start(&im, &p, dir, base, cb);
+    char buf[16 * 1024];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        ok = json_feed(&p, buf, n);
+    }
+    fclose(f);
+    return ok && json_finish(&p) && im.ok;
+}
+
+/// Where a project's external level files are: its directory, with a '/'
+void ldtk_dir(const char *path, char *dir, size_t size) {
+    const char *slash = strrchr(path, '/');
+    size_t n = slash ? (size_t)(slash - path + 1) : 0;
+    if (n >= size) n = 0;
+    memcpy(dir, path, n);
+    dir[n] = '\0';
+}
+
+/// Import a .ldtk project, levels saved separately (.ldtkl) included
+bool ldtk_import_file(const char *path, ldtk_callbacks *cb) {
+    char dir[LDTK_PATH_LEN];
+    ldtk_dir(path, dir, sizeof(dir));
+    return ldtk_parse_file(path, dir, 2, cb);
+}
+
+// Where the levels are, all together, in cells of their IntGrid layers
+typedef struct {
+    int32_t x0;
+    int32_t y0;
+    int32_t x1; // exclusive
+    int32_t y1;
+    uint32_t levels;
+} ldtk_extent;
+
+/// A `level` callback (`ctx` is an ldtk_extent), for sizing a world that
+/// has room for every level where the project puts it
+void ldtk_extend(void *ctx, const ldtk_level *l) {
+    ldtk_extent *e = ctx;
+    if (l->grid_size <= 0) return;
+    int32_t x0 = l->world_x / l->grid_size;
+    int32_t y0 = l->world_y / l->grid_size;
+    int32_t x1 = x0 + (l->px_w + l->grid_size - 1) / l->grid_size;
+    int32_t y1 = y0 + (l->px_h + l->grid_size - 1) / l->grid_size;
+    if (e->levels++ == 0) {
+        *e = (ldtk_extent){ x0, y0, x1, y1, 1 };
+        return;
+    }
+    if (x0 < e->x0) e->x0 = x0;
+    if (y0 < e->y0) e->y0 = y0;
+    if (x1 > e->x1) e->x1 = x1;
+    if (y1 > e->y1) e->y1 = y1;
+}
+
+/// Does this look like JSON rather than CSV?
+bool is_ldtk(const char *bytes, size_t len) {
+    size_t i = 0;
+    while (i < len && json_space(bytes[i])) i++;
+    return i < len && bytes[i] == '{';
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef LEVEL_BIN_H
+#define LEVEL_BIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Binary levels: a header, then a plane of tiles and a plane of tile data,
+// row by row, each run-length coded. Numbers are little-endian.
+//
+//   "TLVL" u16 version, u16 palette, u32 w, u32 h
+//   tiles: u32 length in bytes, then (u8 value, varint count) runs
+//   data:  the same
+//
+// Tiles are palette ids: palette 1 is the numbering of the CSV levels
+// (savefile_idx in terry.c). Data 0 leaves a tile as its id has it, or a
+// LEVEL_DIR_ turns a tile that faces somewhere.
+#define LEVEL_MAGIC "TLVL"
+#define LEVEL_VERSION 1
+#define LEVEL_PALETTE 1
+#define LEVEL_HEADER_SIZE 16
+#define LEVEL_MAX_SIDE (1 << 20)
+
+enum {
+    LEVEL_DIR_NONE,
+    LEVEL_DIR_RIGHT,
+    LEVEL_DIR_LEFT,
+    LEVEL_DIR_DOWN,
+    LEVEL_DIR_UP,
+};
+
+typedef struct {
+    uint16_t version;
+    uint16_t palette;
+    uint32_t w;
+    uint32_t h;
+    const uint8_t *tiles; // coded
+    size_t tiles_len;
+    const uint8_t *data;
+    size_t data_len;
+} level_bin;
+
+// Reading one plane back, a run at a time
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} level_runs;
+
+uint32_t level_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool is_level_bin(const void *bytes, size_t len) {
+    return len >= 4 && memcmp(bytes, LEVEL_MAGIC, 4) == 0;
+}
+
+/// Check the header and find the planes. Doesn't copy anything: `lb`
+/// points into `p`.
+bool parse_level_bin(const uint8_t *p, size_t len, level_bin *lb) {
+    if (!is_level_bin(p, len) || len < LEVEL_HEADER_SIZE + 4) return false;
+    lb->version = p[4] | p[5] << 8;
+    lb->palette = p[6] | p[7] << 8;
+    lb->w = level_u32(p + 8);
+    lb->h = level_u32(p + 12);
+    if (lb->version != LEVEL_VERSION || lb->palette != LEVEL_PALETTE ||
+        lb->w == 0 || lb->h == 0 || lb->w > LEVEL_MAX_SIDE || lb->h > LEVEL_MAX_SIDE) {
+        return false;
+    }
+    size_t at = LEVEL_HEADER_SIZE;
+    lb->tiles_len = level_u32(p + at);
+    at += 4;
+    if (lb->tiles_len > len - at) return false;
+    lb->tiles = p + at;
+    at += lb->tiles_len;
+    if (len - at < 4) return false;
+    lb->data_len = level_u32(p + at);
+    at += 4;
+    if (lb->data_len > len - at) return false;
+    lb->data = p + at;
+    return true;
+}
+
+level_runs level_plane(const uint8_t *coded, size_t len) {
+    return (level_runs){ coded, coded + len };
+}
+
+/// The next run, or false at the end (or on a truncated one)
+bool next_run(level_runs *r, uint8_t *value, uint32_t *count) {
+    if (r->p >= r->end) return false;
+    *value = *r->p++;
+    *count = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (r->p >= r->end) return false;
+        uint8_t b = *r->p++;
+        *count |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return *count > 0;
+    }
+    return false;
+}
+
+void put_level_u32(FILE *f, uint32_t v) {
+    for (int i = 0; i < 4; i++) fputc(v >> (i * 8), f);
+}
+
+/// Run-length code `n` bytes into `out` (which needs up to 2 * n bytes).
+/// Returns the coded length.
+size_t encode_plane(const uint8_t *plane, size_t n, uint8_t *out) {
+    size_t len = 0;
+    for (size_t i = 0; i < n;) {
+        uint8_t v = plane[i];
+        uint32_t count = 1;
+        while (i + count < n && plane[i + count] == v && count < UINT32_MAX) count++;
+        i += count;
+        out[len++] = v;
+        while (count >= 0x80) {
+            out[len++] = 0x80 | (count & 0x7f);
+            count >>= 7;
+        }
+        out[len++] = count;
+    }
+    return len;
+}
+
+bool write_level_bin(FILE *f, uint32_t w, uint32_t h,
+                     const uint8_t *tiles, const uint8_t *data) {
+    size_t n = (size_t)w * h;
+    uint8_t *coded = malloc(n * 2 + 1);
+    if (coded == NULL) return false;
+
+    fwrite(LEVEL_MAGIC, 1, 4, f);
+    fputc(LEVEL_VERSION & 0xff, f);
+    fputc(LEVEL_VERSION >> 8, f);
+    fputc(LEVEL_PALETTE & 0xff, f);
+    fputc(LEVEL_PALETTE >> 8, f);
+    put_level_u32(f, w);
+    put_level_u32(f, h);
+    const uint8_t *planes[] = { tiles, data };
+    for (int i = 0; i < 2; i++) {
+        size_t len = encode_plane(planes[i], n, coded);
+        put_level_u32(f, len);
+        fwrite(coded, 1, len, f);
+    }
+    free(coded);
+    return !ferror(f);
+}
+
+#endif
@@ -0,0 +1,181 @@
+// Convert a level to the binary format terry loads fastest (level_bin.h).
+//
+//   ./levelconv in out.tlvl
+//
+// `in` can be a CSV level (as LDtk's simplified export writes tiles.csv),
+// an LDtk simplified export directory, a level01.txt style file (the width
+// and height on lines of their own, then CSV rows) or a whole LDtk project,
+// which becomes one level with all of its levels where the project puts
+// them. A project's entities are listed, as there are no tiles for them.
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldtk.h"
+#include "level_bin.h"
+
+typedef struct {
+    uint32_t w;
+    uint32_t h;
+    uint8_t *tiles; // w * h palette ids
+} grid;
+
+/// Every number on the line, up to `max` of them (or just count them if
+/// `row` is NULL)
+uint32_t parse_row(const char *line, uint8_t *row, uint32_t max) {
+    uint32_t x = 0;
+    const char *p = line;
+    char *end;
+    while (true) {
+        long id = strtol(p, &end, 10);
+        if (end == p) break;
+        if (row != NULL && x < max) row[x] = id >= 0 && id <= 255 ? id : 0;
+        x++;
+        for (p = end; *p == ',' || *p == ' '; p++);
+    }
+    return x;
+}
+
+/// A line with one number and nothing else, as in level01.txt's header
+bool lone_number(const char *line, long *n) {
+    char *end;
+    *n = strtol(line, &end, 10);
+    if (end == line) return false;
+    while (*end == ' ' || *end == '\r' || *end == '\n') end++;
+    return *end == '\0';
+}
+
+bool read_csv(FILE *f, grid *g) {
+    char *line = NULL;
+    size_t cap = 0;
+    long hw = 0;
+    long hh = 0;
+
+    // level01.txt: "w\nh\n" then the rows, which may run longer than w
+    bool header = getline(&line, &cap, f) > 0 && lone_number(line, &hw) &&
+                  getline(&line, &cap, f) > 0 && lone_number(line, &hh) &&
+                  hw > 0 && hh > 0;
+    if (!header) rewind(f);
+    long start = ftell(f);
+
+    uint32_t w = 0;
+    uint32_t h = 0;
+    while (getline(&line, &cap, f) > 0) {
+        uint32_t n = parse_row(line, NULL, 0);
+        if (n == 0) continue;
+        if (n > w) w = n;
+        h++;
+    }
+    if (header) {
+        w = hw;
+        h = hh < h ? hh : h;
+    }
+    if (w == 0 || h == 0 || w > LEVEL_MAX_SIDE || h > LEVEL_MAX_SIDE) {
+        free(line);
+        return false;
+    }
+
+    g->w = w;
+    g->h = h;
+    g->tiles = calloc((size_t)w * h, 1);
+    if (g->tiles == NULL) {
+        free(line);
+        return false;
+    }
+    fseek(f, start, SEEK_SET);
+    uint32_t y = 0;
+    while (y < h && getline(&line, &cap, f) > 0) {
+        if (parse_row(line, &g->tiles[(size_t)y * w], w) > 0) y++;
+    }
+    free(line);
+    return true;
+}
+
+typedef struct {
+    ldtk_extent ext;
+    grid *g;
+} ldtk_placing;
+
+void place_cell(void *ctx, const ldtk_level *l, const ldtk_layer *layer,
+                int32_t x, int32_t y, int32_t value) {
+    ldtk_placing *pl = ctx;
+    if (strcmp(layer->type, "IntGrid") != 0 || layer->grid_size <= 0) return;
+    x += l->world_x / layer->grid_size - pl->ext.x0;
+    y += l->world_y / layer->grid_size - pl->ext.y0;
+    if (x >= 0 && y >= 0 && (uint32_t)x < pl->g->w && (uint32_t)y < pl->g->h) {
+        pl->g->tiles[(size_t)y * pl->g->w + x] = value >= 0 && value <= 255 ? value : 0;
+    }
+}
+
+void list_level(void *ctx, const ldtk_level *l) {
+    printf("  %s: %dx%d px at %d,%d\n", l->identifier, l->px_w, l->px_h, l->world_x, l->world_y);
+}
+
+void list_entity(void *ctx, const ldtk_level *l, const ldtk_layer *layer, const ldtk_entity *e) {
+    printf("  %s: %s at %d,%d\n", l->identifier, e->identifier, e->grid_x, e->grid_y);
+}
+
+bool read_ldtk(const char *path, grid *g) {
+    ldtk_placing pl = { .g = g };
+    ldtk_callbacks sizing = { .ctx = &pl.ext, .level = ldtk_extend };
+    if (!ldtk_import_file(path, &sizing) || pl.ext.levels == 0) return false;
+    g->w = pl.ext.x1 - pl.ext.x0;
+    g->h = pl.ext.y1 - pl.ext.y0;
+    if (g->w > LEVEL_MAX_SIDE || g->h > LEVEL_MAX_SIDE) return false;
+    g->tiles = calloc((size_t)g->w * g->h, 1);
+    if (g->tiles == NULL) return false;
+    ldtk_callbacks filling = {
+        .ctx = &pl, .level = list_level, .cell = place_cell, .entity = list_entity,
+    };
+    return ldtk_import_file(path, &filling);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s in.csv|level01.txt|export-dir|project.ldtk out.tlvl\n", argv[0]);
+        return 1;
+    }
+    char path[4096];
+    struct stat st;
+    if (stat(argv[1], &st) == 0 && S_ISDIR(st.st_mode)) {
+        snprintf(path, sizeof(path), "%s/tiles.csv", argv[1]);
+    } else {
+        snprintf(path, sizeof(path), "%s", argv[1]);
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+    char start[64];
+    size_t n = fread(start, 1, sizeof(start), in);
+    rewind(in);
+    grid g = {0};
+    bool ok;
+    if (is_ldtk(start, n)) {
+        printf("%s:\n", path);
+        ok = read_ldtk(path, &g);
+    } else {
+        ok = read_csv(in, &g);
+    }
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "No level in %s\n", path);
+        return 1;
+    }
+
+    // Nothing in the text formats has a direction beyond what its id says
+    uint8_t *data = calloc((size_t)g.w * g.h, 1);
+    FILE *out = fopen(argv[2], "wb");
+    if (data == NULL || out == NULL || !write_level_bin(out, g.w, g.h, g.tiles, data)) {
+        fprintf(stderr, "Can't write %s\n", argv[2]);
+        return 1;
+    }
+    fclose(out);
+    printf("%s: %ux%u\n", argv[2], g.w, g.h);
+    return 0;
+}
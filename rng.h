@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// PCG32 (pcg-random.org): 8 bytes of state and an odd stream id, no locks
+// and no hidden globals, so every user gets its own reproducible stream.
+typedef struct {
+    uint64_t state;
+    uint64_t inc; // stream id, always odd
+} rng;
+
+uint32_t rng_next(rng *r) {
+    uint64_t old = r->state;
+    r->state = old * 6364136223846793005ULL + r->inc;
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/// Same seed, same stream: same numbers. Different streams from one seed
+/// don't overlap.
+rng make_rng(uint64_t seed, uint64_t stream) {
+    rng r = { .state = 0, .inc = (stream << 1) | 1 };
+    rng_next(&r);
+    r.state += seed;
+    rng_next(&r);
+    return r;
+}
+
+uint64_t rng_next64(rng *r) {
+    uint64_t hi = rng_next(r);
+    return (hi << 32) | rng_next(r);
+}
+
+/// Uniform-ish in [0, n): multiply and shift instead of a modulo
+uint32_t rng_below(rng *r, uint32_t n) {
+    return ((uint64_t)rng_next(r) * n) >> 32;
+}
+
+/// Counter-based: a number from a seed and three counters, with no state at
+/// all, for when there's no fixed order to draw from a stream in.
+uint32_t rng_hash(uint64_t seed, uint32_t a, uint32_t b, uint32_t c) {
+    uint64_t h = seed ^ (a * 0x9E3779B97F4A7C15ULL);
+    h ^= (uint64_t)b * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (uint64_t)c * 0x165667B19E3779F9ULL;
+    // splitmix64 finaliser
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return (h ^ (h >> 31)) >> 32;
+}
+
+#endif
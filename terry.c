@@ -1,4 +1,14 @@
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -8,6 +18,10 @@
 #include <unistd.h>
 
 #include "ansi_keys.h"
+#include "ansi_out.h"
+#include "ldtk.h"
+#include "level_bin.h"
+#include "rng.h"
 
 #define min(a,b) \
    ({ __typeof__ (a) _a = (a); \
@@ -38,30 +52,70 @@
 #define C_DARKEST_GREY 235
 
 
-#define delay 1000000 / 30
+// Rendering and simulation run on separate clocks
+#define DEFAULT_FPS 30
+#define DEFAULT_TICK_HZ 7.5   // tile updates per second
+#define FX_HZ 30              // particle updates per second
+#define MAX_CATCHUP_TICKS 5   // after a stall, drop time rather than tick more
+#define NS_PER_SEC 1000000000ULL
 
 uint16_t scr_w = 0;
 uint16_t scr_h = 0;
 struct winsize win;
 
 uint8_t pixels[PIX_H][PIX_W] = {0};
+typedef const uint8_t (*frame_pixels)[PIX_W];
+// What the terminal is currently showing: only cells that differ get re-sent
+uint8_t pixels_front[PIX_H][PIX_W] = {0};
+bool full_repaint = true;
 
-// World size
-#define TILE_COLS 41
-#define TILE_ROWS 25
+// How `pixels` become characters
+typedef enum {
+    RENDER_HALF_BLOCK, // 1x2 pixels per cell: "▀"/"▄"
+    RENDER_SEXTANT     // 2x3 pixels per cell: Unicode 13 sextants
+} render_mode;
+
+render_mode renderer = RENDER_HALF_BLOCK;
+// Character cell size in pixels: the camera moves in whole cells so the
+// terminal can scroll what it already has.
+uint8_t cell_w = 1;
+uint8_t cell_h = 2;
+bool term_margins = false; // terminal supports DECSLRM scroll regions
+int32_t front_cam_x = 0;  // camera position `pixels_front` was drawn at
+int32_t front_cam_y = 0;
+
+// Frame output is built up here and written in one go
+ansi_out *out;
+
+// Randomness comes in separate streams, all from one seed (-S): what the
+// simulation does is reproducible, and no amount of eye candy changes it.
+enum {
+    RNG_LEVELS, // seeds for random levels
+    RNG_SIM,    // random_level's layout
+    RNG_FX,     // particles, sprite noise: main thread only
+    RNG_STARS   // background, drawn by the output thread
+};
+
+uint64_t seed = 0;
+rng levels_rng;
+rng fx_rng;
+
+// Size of generated levels (loaded levels bring their own)
+#define DEFAULT_WORLD_W 41
+#define DEFAULT_WORLD_H 25
 
 typedef struct { int8_t x; int8_t y; } dir;
-typedef struct { uint8_t x; uint8_t y; } point;
+typedef struct { int32_t x; int32_t y; } point;
 
 typedef struct {
-    uint8_t x;
-    uint8_t y;
+    int32_t x;
+    int32_t y;
     int8_t dx;
     int8_t dy;
     uint32_t t;
     dir  dir;
-    uint8_t cam_x;
-    uint8_t cam_y;
+    int32_t cam_x; // top-left of the view, in world pixels
+    int32_t cam_y;
     int16_t lives;
     uint8_t slot;
     uint16_t tail;
@@ -70,27 +124,53 @@ typedef struct {
     bool dig;
 } player_state;
 
+// What a tile type is, as bits: the predicates below are one test each
+enum {
+    TP_ROUND = 1 << 0,       // things roll off it
+    TP_EXPLODABLE = 1 << 1,  // goes off when hit or caught in a blast
+    TP_CONSUMABLE = 1 << 2,  // a blast turns it into an explosion
+    TP_PUSHABLE = 1 << 3,
+    TP_OPEN = 1 << 4,        // can be moved or shot into
+    TP_EMPTY = 1 << 5,       // falls through
+    TP_PLAYER = 1 << 6,      // the player or their tail
+    TP_ALIVE = 1 << 7,
+    TP_ACTIVE = 1 << 8,      // stays awake whatever's around it
+    TP_FLIES = 1 << 9,       // and so does this, while it has a direction
+    TP_CRUMBLES = 1 << 10,   // and this, while its ticks count down
+    TP_SERIAL = 1 << 11,     // reaches across the world: no parallel ticks
+};
+
+// Every tile type, once: how it updates when its tick comes (NULL if it
+// never does anything), how it's drawn (a sprite, or a function picking one
+// from its data) and what it is. The enum and the tables are all made from
+// this list, in this order.
+//
+//  X(name,           update,               sprite,          look,           props)
+#define TILE_TYPES(X) \
+    X(EMPTY,           NULL,                 SPR_EMPTY,       NULL,           TP_OPEN | TP_EMPTY | TP_CONSUMABLE) \
+    X(AMOEBA,          tick_amoeba,          SPR_AMOEBA,      NULL,           0) \
+    X(BALLOON,         tick_balloon,         SPR_BALLOON,     NULL,           TP_ROUND | TP_CONSUMABLE | TP_PUSHABLE) \
+    X(BALLOON_RISING,  tick_balloon_rising,  SPR_BALLOON,     NULL,           TP_CONSUMABLE | TP_ACTIVE) \
+    X(BEAM,            tick_beam,            SPR_BEAM,        NULL,           TP_OPEN | TP_EMPTY | TP_SERIAL) \
+    X(BEDROCK,         NULL,                 SPR_BEDROCK,     NULL,           TP_ROUND) \
+    X(BULLET,          tick_shootable,       SPR_BULLET,      NULL,           TP_EXPLODABLE | TP_CONSUMABLE | TP_ACTIVE) \
+    X(DIAMOND,         tick_diamond,         SPR_DIAMOND,     NULL,           TP_ROUND | TP_CONSUMABLE) \
+    X(DIAMOND_FALLING, tick_diamond_falling, SPR_DIAMOND,     NULL,           TP_CONSUMABLE | TP_ACTIVE) \
+    X(DISSOLVER,       tick_dissolver,       SPR_DISSOLVER,   look_dissolver, TP_ROUND | TP_CRUMBLES) \
+    X(EXP,             tick_exp,             SPR_EXP,         NULL,           TP_ACTIVE) \
+    X(EXP_DIAMOND,     tick_exp_diamond,     SPR_EXP,         NULL,           TP_ACTIVE) \
+    X(FIREFLY,         tick_firefly,         SPR_FIREFLY,     look_firefly,   TP_EXPLODABLE | TP_CONSUMABLE | TP_ALIVE | TP_ACTIVE) \
+    X(LASER,           tick_laser,           SPR_BULLET,      NULL,           TP_SERIAL) \
+    X(PLAYER,          tick_player,          SPR_PLAYER_R,    look_player,    TP_EXPLODABLE | TP_CONSUMABLE | TP_PLAYER | TP_ALIVE | TP_ACTIVE) \
+    X(PLAYER_TAIL,     tick_player_tail,     SPR_PLAYER_TAIL, NULL,           TP_EXPLODABLE | TP_PLAYER | TP_ALIVE | TP_ACTIVE) \
+    X(ROCK,            tick_rock,            SPR_ROCK,        NULL,           TP_ROUND | TP_CONSUMABLE | TP_PUSHABLE | TP_FLIES) \
+    X(ROCK_FALLING,    tick_rock_falling,    SPR_ROCK,        NULL,           TP_CONSUMABLE | TP_ACTIVE) \
+    X(SANDSTONE,       tick_shootable,       SPR_SANDSTONE,   NULL,           TP_ROUND | TP_CONSUMABLE | TP_PUSHABLE | TP_FLIES) \
+    X(SAND,            NULL,                 SPR_SAND,        NULL,           TP_ROUND | TP_OPEN | TP_CONSUMABLE)
+
+#define TILE_ENUM(name, update, sprite, look, props) TILE_##name,
 typedef enum {
-    TILE_EMPTY,
-    TILE_AMOEBA,
-    TILE_BALLOON,
-    TILE_BALLOON_RISING,
-    TILE_BEAM,
-    TILE_BEDROCK,
-    TILE_BULLET,
-    TILE_DIAMOND,
-    TILE_DIAMOND_FALLING,
-    TILE_DISSOLVER,
-    TILE_EXP,
-    TILE_EXP_DIAMOND,
-    TILE_FIREFLY,
-    TILE_LASER,
-    TILE_PLAYER,
-    TILE_PLAYER_TAIL,
-    TILE_ROCK,
-    TILE_ROCK_FALLING,
-    TILE_SANDSTONE,
-    TILE_SAND,
+    TILE_TYPES(TILE_ENUM)
     TILE__LEN
 } tile_type;
 
@@ -111,39 +191,8 @@ tile_type savefile_idx[] = {
     [13] = TILE_DISSOLVER
 };
 
-typedef struct {
-    bool round;
-    bool explodable;
-    bool consumable;
-    bool pushable;
-} tile_deets;
-
-#define T true
-#define F false
-
-const tile_deets tiledefs[TILE__LEN] = {
-    [TILE_EMPTY] =        { F, F, T, F },
-    [TILE_BEDROCK] =      { T, F, F, F },
-    [TILE_BEAM] =         { F, F, F, F },
-    [TILE_PLAYER] =       { F, T, T, F },
-    [TILE_PLAYER_TAIL] =  { F, T, F, F },
-    [TILE_ROCK] =         { T, F, T, T },
-    [TILE_ROCK_FALLING] = { F, F, T, F },
-    [TILE_SANDSTONE] =    { T, F, T, T },
-    [TILE_SAND] =         { T, F, T, F },
-    [TILE_DIAMOND] =      { T, F, T, F },
-    [TILE_DIAMOND_FALLING] = { F, F, T, F},
-    [TILE_DISSOLVER] =    { T, F, F, F },
-    [TILE_BALLOON] =      { T, F, T, T },
-    [TILE_BALLOON_RISING] = { F, F, T, F },
-    [TILE_EXP] =          { F, F, F, F },
-    [TILE_EXP_DIAMOND] =  { F, F, F, F },
-    [TILE_LASER] =        { F, F, F, F },
-    [TILE_FIREFLY] =      { F, T, T, F },
-    [TILE_AMOEBA] =       { F, F, F, F },
-    [TILE_BULLET] =       { F, T, T, F },
-
-};
+#define TILE_PROPS(name, update, sprite, look, props) [TILE_##name] = props,
+const uint16_t tile_props[TILE__LEN] = { TILE_TYPES(TILE_PROPS) };
 
 const uint8_t pal[] = {
     [0] = C_BLACK,
@@ -211,25 +260,387 @@ const uint8_t tile_gfx[][16] = {
     },
 };
 
-typedef enum {
-    TD_TICKS,
-    TD_DIR
-} tile_data_type;
+// A straight run of tiles: for a laser, its beam; for a beam cell, the
+// direction of its laser's beam and how far back along it the laser is.
+typedef struct {
+    dir dir;
+    uint16_t len;
+} segment;
 
+// What a tile remembers besides its type. Which one it is depends on the
+// type, and on the chunk's `has_dir` bit for tiles that can be either.
 typedef union {
     dir dir;
     int32_t ticks;
+    segment seg; // lasers and beams; `dir` is the same as seg.dir
 } tile_data;
 
+// ============= Sprites ==================
+
+// Every tile look, palette-resolved at startup. Noisy/animated ones get
+// SPR_FRAMES random variants; static ones just repeat frame 0.
+#define SPR_FRAMES 8
+#define SPR_SIZE (px_per_tile * px_per_tile)
+
+typedef enum {
+    SPR_EMPTY,
+    SPR_AMOEBA,
+    SPR_BALLOON,
+    SPR_BEAM,
+    SPR_BEDROCK,
+    SPR_BULLET,
+    SPR_DIAMOND,
+    SPR_DISSOLVER,
+    SPR_DISSOLVING, // frame = ticks left
+    SPR_EXP,
+    SPR_FIREFLY,
+    SPR_FIREFLY_L,
+    SPR_FIREFLY_R,
+    SPR_FIREFLY_U,
+    SPR_FIREFLY_D,
+    SPR_FLASH,
+    SPR_PLAYER_L,
+    SPR_PLAYER_R,
+    SPR_PLAYER_DIG_L,
+    SPR_PLAYER_DIG_R,
+    SPR_PLAYER_TAIL,
+    SPR_ROCK,
+    SPR_SAND,
+    SPR_SANDSTONE,
+    SPR__LEN
+} sprite_id;
+
+uint8_t atlas[SPR__LEN][SPR_FRAMES][SPR_SIZE];
+bool sprite_animated[SPR__LEN] = {
+    [SPR_AMOEBA] = true,
+    [SPR_EXP] = true,
+    [SPR_FIREFLY] = true,
+    [SPR_FIREFLY_L] = true,
+    [SPR_FIREFLY_R] = true,
+    [SPR_FIREFLY_U] = true,
+    [SPR_FIREFLY_D] = true,
+    [SPR_FLASH] = true,
+    [SPR_PLAYER_DIG_L] = true,
+    [SPR_PLAYER_DIG_R] = true,
+};
+
+// tile_gfx are 4x4: scale them to whatever px_per_tile is
+uint8_t gfx_px(tile_type t, uint8_t i, uint8_t j) {
+    return pal[tile_gfx[t][(j * 4 / px_per_tile) * 4 + (i * 4 / px_per_tile)]];
+}
+
+uint8_t sprite_px(sprite_id id, uint8_t f, uint8_t i, uint8_t j) {
+    switch (id) {
+    case SPR_EMPTY: return C_BLACK;
+    case SPR_AMOEBA: return 17 + rng_below(&fx_rng, 5);
+    case SPR_BALLOON: return gfx_px(TILE_BALLOON, i, j);
+    case SPR_BEAM: return gfx_px(TILE_BEAM, i, j);
+    case SPR_BEDROCK: return gfx_px(TILE_BEDROCK, i, j);
+    case SPR_BULLET: return gfx_px(TILE_BULLET, i, j);
+    case SPR_DIAMOND: return gfx_px(TILE_DIAMOND, i, j);
+    case SPR_DISSOLVER: return gfx_px(TILE_DISSOLVER, i, j);
+    case SPR_DISSOLVING: return 200 + f;
+    case SPR_EXP: return rng_below(&fx_rng, 232-196)+197;
+    case SPR_FIREFLY:
+    case SPR_FIREFLY_L:
+    case SPR_FIREFLY_R:
+    case SPR_FIREFLY_U:
+    case SPR_FIREFLY_D:
+        if (i == 0 && j == 0) {
+            if (id == SPR_FIREFLY_L) return C_YELLOW;
+            if (id == SPR_FIREFLY_R) return C_LIGHTGREY;
+            if (id == SPR_FIREFLY_U) return C_BLACK;
+            if (id == SPR_FIREFLY_D) return C_MAROON;
+        }
+        return 0xc5 + rng_below(&fx_rng, 5);
+    case SPR_FLASH: return 48 + rng_below(&fx_rng, 3);
+    case SPR_PLAYER_L:
+    case SPR_PLAYER_R:
+    case SPR_PLAYER_DIG_L:
+    case SPR_PLAYER_DIG_R: {
+        bool left = id == SPR_PLAYER_L || id == SPR_PLAYER_DIG_L;
+        bool dig = id == SPR_PLAYER_DIG_L || id == SPR_PLAYER_DIG_R;
+        if (j == 1 && (i % 2) == (left ? 1 : 0)) return 0xcd; // eyes
+        return !dig ? pal[10] : (0xe0 + rng_below(&fx_rng, 5));
+    }
+    case SPR_PLAYER_TAIL: return pal[10];
+    case SPR_ROCK: return gfx_px(TILE_ROCK, i, j);
+    case SPR_SAND: return ((i + j) % 2) ? 0x3a : pal[4]; // checkerboard
+    case SPR_SANDSTONE: return gfx_px(TILE_SANDSTONE, i, j);
+    default: return C_BLACK;
+    }
+}
+
+void init_sprites() {
+    for (uint8_t id = 0; id < SPR__LEN; id++) {
+        for (uint8_t f = 0; f < SPR_FRAMES; f++) {
+            for (uint8_t j = 0; j < px_per_tile; j++) {
+                for (uint8_t i = 0; i < px_per_tile; i++) {
+                    atlas[id][f][j * px_per_tile + i] = sprite_px(id, f, i, j);
+                }
+            }
+        }
+    }
+}
+
+// Tiles whose look depends on their data (or the player's state) pick a
+// sprite and frame themselves
+sprite_id look_dissolver(tile_data data, player_state *s, uint8_t *f) {
+    if (data.ticks < 0) return SPR_DISSOLVER; // not touched yet
+    *f = min(SPR_FRAMES - 1, max(0, data.ticks));
+    return SPR_DISSOLVING;
+}
+
+sprite_id look_firefly(tile_data data, player_state *s, uint8_t *f) {
+    dir d = data.dir;
+    sprite_id id = SPR_FIREFLY;
+    if (d.x < 0) id = SPR_FIREFLY_L;
+    if (d.x > 0) id = SPR_FIREFLY_R;
+    if (d.y < 0) id = SPR_FIREFLY_U;
+    if (d.y > 0) id = SPR_FIREFLY_D;
+    return id;
+}
+
+sprite_id look_player(tile_data data, player_state *s, uint8_t *f) {
+    if (s->dir.x < 0) return s->dig ? SPR_PLAYER_DIG_L : SPR_PLAYER_L;
+    return s->dig ? SPR_PLAYER_DIG_R : SPR_PLAYER_R;
+}
+
+typedef sprite_id (*tile_look)(tile_data data, player_state *s, uint8_t *f);
+
+#define TILE_SPRITE(name, update, sprite, look, props) [TILE_##name] = sprite,
+#define TILE_LOOK(name, update, sprite, look, props) [TILE_##name] = look,
+const sprite_id tile_sprites[TILE__LEN] = { TILE_TYPES(TILE_SPRITE) };
+const tile_look tile_looks[TILE__LEN] = { TILE_TYPES(TILE_LOOK) };
+
+const uint8_t *tile_sprite(tile_type t, tile_data data, player_state *s) {
+    sprite_id id = tile_sprites[t];
+    uint8_t f = 0;
+    if (tile_looks[t]) id = tile_looks[t](data, s, &f);
+    if (sprite_animated[id]) f = rng_below(&fx_rng, SPR_FRAMES);
+    return atlas[id][f];
+}
+
+// ============= World ==================
+
+// The world is a grid of fixed-size chunks, allocated the first time
+// something other than TILE_EMPTY is written to them: a mostly empty map only
+// costs the chunks that have something in them, and a tile is still just
+// two shifts and an index away.
+#define CHUNK_BITS 5
+#define CHUNK_SIZE (1 << CHUNK_BITS) // 32x32 tiles
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+// Stored as planes rather than an array of structs: the scans mostly only
+// look at types, a byte each, and 32 of them are a cache line.
 typedef struct {
-    tile_data_type type;
-    tile_data data;
-} tagged_tile_data;
+    uint8_t types[CHUNK_SIZE][CHUNK_SIZE];  // tile_type
+    tile_data data[CHUNK_SIZE][CHUNK_SIZE];
+    uint32_t has_dir[CHUNK_SIZE];           // `data` is a dir, not ticks
+    // Tiles that may do something on the next tick: set_tile wakes the tile
+    // and its neighbours, and a tile goes back to sleep once a tick leaves
+    // it be. tick_tiles only visits awake tiles. One bit per column.
+    uint32_t awake[CHUNK_SIZE];
+    // Tiles already updated this tick; a row's bits only count if its
+    // `ticked_gen` is the current tick, so nothing needs clearing between
+    // ticks. Per row, so parallel ticks (which never share a row) don't race.
+    uint32_t ticked[CHUNK_SIZE];
+    uint32_t ticked_gen[CHUNK_SIZE];
+    // Tiles whose type or data changed since the rewind buffer last looked,
+    // while track_changes is on; `listed` once it's in changed_chunks.
+    uint32_t changed[CHUNK_SIZE];
+    bool listed;
+} chunk;
 
 typedef struct {
-    tile_type type;
-    tagged_tile_data tile_data;
-} tile;
+    int32_t w;          // in tiles
+    int32_t h;
+    int32_t cols;       // in chunks
+    int32_t rows;
+    chunk **chunks;     // cols * rows, NULL while empty
+    uint32_t *row_awake; // awake tiles in each row of tiles
+    uint32_t tick_gen;
+    uint64_t seed;      // for everything random the simulation does
+    size_t num_chunks;  // allocated so far
+    uint32_t *changed_chunks; // indices of chunks with `changed` bits
+    uint32_t num_changed;
+    bool far_reaching;  // has had a TP_SERIAL tile in it
+} world;
+
+world world_state = {0};
+bool track_changes = false;
+
+void free_world() {
+    world *wd = &world_state;
+    for (int32_t i = 0; i < wd->cols * wd->rows; i++) {
+        free(wd->chunks[i]);
+    }
+    free(wd->chunks);
+    free(wd->row_awake);
+    free(wd->changed_chunks);
+    *wd = (world){0};
+}
+
+/// Replace the world with an empty one of `w` x `h` tiles
+bool init_world(int32_t w, int32_t h, uint64_t world_seed) {
+    free_world();
+    if (w <= 0 || h <= 0) return false;
+    world *wd = &world_state;
+    wd->cols = (w + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    wd->rows = (h + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    wd->chunks = calloc((size_t)wd->cols * wd->rows, sizeof(chunk *));
+    wd->row_awake = calloc(h, sizeof(uint32_t));
+    wd->changed_chunks = calloc((size_t)wd->cols * wd->rows, sizeof(uint32_t));
+    if (wd->chunks == NULL || wd->row_awake == NULL || wd->changed_chunks == NULL) {
+        free_world();
+        return false;
+    }
+    wd->w = w;
+    wd->h = h;
+    wd->tick_gen = 1;
+    wd->seed = world_seed;
+    return true;
+}
+
+bool in_world(int32_t x, int32_t y) {
+    return x >= 0 && y >= 0 && x < world_state.w && y < world_state.h;
+}
+
+/// The chunk holding (x, y), or NULL if it's empty. (x, y) must be in the world.
+chunk *get_chunk(int32_t x, int32_t y) {
+    chunk **c = &world_state.chunks[(y >> CHUNK_BITS) * world_state.cols + (x >> CHUNK_BITS)];
+    return __atomic_load_n(c, __ATOMIC_ACQUIRE);
+}
+
+/// Strips of a parallel tick can both be writing near a chunk that isn't
+/// there yet: the first one to publish it wins.
+chunk *alloc_chunk(int32_t x, int32_t y) {
+    chunk **c = &world_state.chunks[(y >> CHUNK_BITS) * world_state.cols + (x >> CHUNK_BITS)];
+    chunk *cur = __atomic_load_n(c, __ATOMIC_ACQUIRE);
+    if (cur != NULL) return cur;
+
+    chunk *fresh = calloc(1, sizeof(chunk)); // all TILE_EMPTY
+    if (fresh == NULL) {
+        fprintf(stderr, "Out of memory for world chunks\n");
+        exit(1);
+    }
+    if (!__atomic_compare_exchange_n(c, &cur, fresh, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(fresh);
+        return cur;
+    }
+    __atomic_add_fetch(&world_state.num_chunks, 1, __ATOMIC_RELAXED);
+    return fresh;
+}
+
+// The row this thread is on while it ticks a strip of a parallel tick (see
+// tick_strips), else -1. Strips share rows, so their counts need atomics.
+__thread int32_t strip_row = -1;
+
+void count_awake(int32_t y, int32_t n) {
+    if (strip_row >= 0) {
+        __atomic_add_fetch(&world_state.row_awake[y], n, __ATOMIC_RELAXED);
+    } else {
+        world_state.row_awake[y] += n;
+    }
+}
+
+void wake_tile(int32_t x, int32_t y) {
+    if (!in_world(x, y)) return;
+    chunk *c = get_chunk(x, y);
+    if (c == NULL) return; // nothing there to do anything
+    uint32_t bit = 1U << (x & CHUNK_MASK);
+    if (c->awake[y & CHUNK_MASK] & bit) return;
+    c->awake[y & CHUNK_MASK] |= bit;
+    count_awake(y, 1);
+}
+
+void sleep_tile(int32_t x, int32_t y) {
+    chunk *c = get_chunk(x, y);
+    uint32_t bit = 1U << (x & CHUNK_MASK);
+    if (!(c->awake[y & CHUNK_MASK] & bit)) return;
+    c->awake[y & CHUNK_MASK] &= ~bit;
+    count_awake(y, -1);
+}
+
+void wake_around(int32_t x, int32_t y) {
+    for (int8_t j = -1; j <= 1; j++) {
+        for (int8_t i = -1; i <= 1; i++) {
+            wake_tile(x + i, y + j);
+        }
+    }
+}
+
+/// First awake tile in row `y` in columns [from, to), or -1
+int32_t next_awake(int32_t y, int32_t from, int32_t to) {
+    if (from >= to || __atomic_load_n(&world_state.row_awake[y], __ATOMIC_RELAXED) == 0) return -1;
+    for (int32_t cx = from >> CHUNK_BITS; cx <= (to - 1) >> CHUNK_BITS; cx++) {
+        chunk *c = get_chunk(cx << CHUNK_BITS, y);
+        if (c == NULL) continue;
+        uint32_t bits = c->awake[y & CHUNK_MASK];
+        if (cx == from >> CHUNK_BITS) bits &= ~0U << (from & CHUNK_MASK);
+        if (bits) {
+            int32_t x = (cx << CHUNK_BITS) + __builtin_ctz(bits);
+            return x < to ? x : -1;
+        }
+    }
+    return -1;
+}
+
+/// After the world's been overwritten wholesale: everything in it gets a
+/// look on the next tick. A tile with nothing to do goes straight back to
+/// sleep, so this costs that one tick some time but changes nothing.
+void wake_all() {
+    world *wd = &world_state;
+    memset(wd->row_awake, 0, wd->h * sizeof(uint32_t));
+    for (uint32_t i = 0; i < (uint32_t)(wd->cols * wd->rows); i++) {
+        chunk *c = wd->chunks[i];
+        if (c == NULL) continue;
+        int32_t y0 = (i / wd->cols) * CHUNK_SIZE;
+        for (int32_t r = 0; r < CHUNK_SIZE; r++) {
+            uint32_t bits = 0;
+            for (int32_t x = 0; x < CHUNK_SIZE; x++) {
+                if (c->types[r][x] != TILE_EMPTY) bits |= 1U << x;
+            }
+            c->awake[r] = bits;
+            c->ticked_gen[r] = 0;
+            if (y0 + r < wd->h) wd->row_awake[y0 + r] += __builtin_popcount(bits);
+        }
+    }
+}
+
+bool is_ticked(int32_t x, int32_t y) {
+    chunk *c = get_chunk(x, y);
+    if (c == NULL || c->ticked_gen[y & CHUNK_MASK] != world_state.tick_gen) return false;
+    return c->ticked[y & CHUNK_MASK] & (1U << (x & CHUNK_MASK));
+}
+
+void mark_ticked(chunk *c, int32_t x, int32_t y) {
+    if (c->ticked_gen[y & CHUNK_MASK] != world_state.tick_gen) {
+        c->ticked[y & CHUNK_MASK] = 0;
+        c->ticked_gen[y & CHUNK_MASK] = world_state.tick_gen;
+    }
+    c->ticked[y & CHUNK_MASK] |= 1U << (x & CHUNK_MASK);
+}
+
+/// Note that (x, y) is being written to, for the rewind buffer. Rows aren't
+/// shared by parallel ticks but chunks are, hence the atomics for the list.
+void mark_changed(chunk *c, int32_t x, int32_t y) {
+    if (!track_changes) return;
+    c->changed[y & CHUNK_MASK] |= 1U << (x & CHUNK_MASK);
+    if (!__atomic_exchange_n(&c->listed, true, __ATOMIC_RELAXED)) {
+        uint32_t n = __atomic_fetch_add(&world_state.num_changed, 1, __ATOMIC_RELAXED);
+        world_state.changed_chunks[n] = (y >> CHUNK_BITS) * world_state.cols + (x >> CHUNK_BITS);
+    }
+}
+
+/// Random numbers for the simulation: a cell rolls the same on a given tick
+/// of a given world whatever order (or thread) it's updated in.
+uint32_t cell_rand(int32_t x, int32_t y) {
+    return rng_hash(world_state.seed, x, y, world_state.tick_gen);
+}
+
+// ======================================
 
 // ============= Particles ==================
 
@@ -246,8 +657,8 @@ particle ps[MAX_PARTICLES] = {0};
 
 void init_particles() {
     for (int i = 0; i < MAX_PARTICLES; i++) {
-        ps[i].x = rand() % (TILE_COLS * px_per_tile);
-        ps[i].y = rand() % (TILE_ROWS * px_per_tile);
+        ps[i].x = rng_below(&fx_rng, max(1, world_state.w * px_per_tile));
+        ps[i].y = rng_below(&fx_rng, max(1, world_state.h * px_per_tile));
     }
 }
 
@@ -263,8 +674,8 @@ void set_particles(uint32_t x, uint32_t y, uint8_t num) {
     for (int i = 0; i < MAX_PARTICLES; i++) {
         if (ps[i].life == -1) {
             ps[i].life = 10;
-            ps[i].x = x + (rand() % 7) - 3;
-            ps[i].y = y + (rand() % 7) - 3;
+            ps[i].x = x + rng_below(&fx_rng, 7) - 3;
+            ps[i].y = y + rng_below(&fx_rng, 7) - 3;
             if(--num <= 0) {
                 return;
             }
@@ -273,76 +684,78 @@ void set_particles(uint32_t x, uint32_t y, uint8_t num) {
 }
 
 void render_particles(player_state *s) {
-    uint16_t x = min(TILE_COLS - SCR_TW, max(0, s->x - (SCR_TW / 2))) * px_per_tile;
-    uint16_t y = min(TILE_ROWS - SCR_TH, max(0, s->y - (SCR_TH / 2))) * px_per_tile;
+    int32_t x = s->cam_x;
+    int32_t y = s->cam_y;
 
     for (uint32_t i = 0; i < MAX_PARTICLES; i++) {
         if (ps[i].life <= 0) continue;
         if (ps[i].x - x < 0 || ps[i].x - x >= PIX_W) continue;
         if (ps[i].y - y < 0 || ps[i].y - y >= PIX_H) continue;
         uint8_t *cur = &(pixels[ps[i].y - y][ps[i].x - x]);
-        if (rand() % 10 < 3) continue;
-        *cur = 32 + rand() % 10;
+        if (rng_below(&fx_rng, 10) < 3) continue;
+        *cur = 32 + rng_below(&fx_rng, 10);
     }
 }
 
 // ===========================================
 
 
-tile bedrocked = {.type=TILE_BEDROCK, .tile_data.type=TD_TICKS};
+bool tile_is(tile_type t, uint16_t props) {
+    return tile_props[t] & props;
+}
 
 bool is_open_tile (tile_type t) {
-    return t == TILE_EMPTY || t == TILE_SAND || t == TILE_BEAM;
+    return tile_is(t, TP_OPEN);
 }
 
 bool is_empty_tile (tile_type t) {
-    return t == TILE_EMPTY || t == TILE_BEAM;
+    return tile_is(t, TP_EMPTY);
 }
 
 bool is_player (tile_type t) {
-    return t == TILE_PLAYER || t == TILE_PLAYER_TAIL;
+    return tile_is(t, TP_PLAYER);
 }
 
 bool is_alive (tile_type t) {
-    return is_player(t) || t == TILE_FIREFLY;
+    return tile_is(t, TP_ALIVE);
 }
 
 
-tile tiles[TILE_ROWS][TILE_COLS] = {0};
-bool tiles_ticked[TILE_ROWS][TILE_COLS] = {false};
-
-void done(int signum);
-
 void esc(char* str) {
-    printf("\e[%s", str);
+    out_esc(out, str);
 }
 
 void cursor_to(uint16_t x, uint16_t y) {
-    printf("\e[%d;%dH", y, x);
+    out_cursor_to(out, x, y);
 }
 
 void set_bg(uint8_t col) {
-    printf("\e[48;5;%dm", col);
+    out_bg(out, col);
 }
 
 void set_fg(uint8_t col) {
-    printf("\e[38;5;%dm", col);
+    out_fg(out, col);
 }
 
 // only on terminals with 24bit color support
 void set_bg_rgb(uint8_t r, uint8_t g, uint8_t b) {
-    printf("\e[48;2;%d;%d;%dm", r, g, b);
+    out_printf(out, "\e[48;2;%d;%d;%dm", r, g, b);
+}
+
+void cursor_fwd(uint16_t n) {
+    out_cursor_fwd(out, n);
 }
 
 void cls() {
     set_bg(C_BLACK);
     set_fg(C_WHITE);
     esc("2J"); // clear screen
+    full_repaint = true;
 }
 
 // Use the half-block char to make squarer, double res pixels
 void print_half_block() {
-    printf("\u2580"); // Upper Half Block "▀"
+    out_half_block(out); // Upper Half Block "▀"
 }
 
 void init_pixels() {
@@ -355,19 +768,112 @@ void init_pixels() {
 
 void init() {
     init_ansi_keys(true);
+    fflush(stdout);
     esc("?25l"); // hide cursor
     init_pixels();
+    init_sprites();
 }
 
-void render_pixels() {
-    for (uint8_t j = 0; j < PIX_H - 1; j+=2) {
-        cursor_to(scr_w / 2 - (PIX_W / 2), scr_h / 2 - (PIX_H / 4) + j / 2 + 1);
-        for (uint8_t i = 0; i < PIX_W; i++) {
-            uint8_t top = pixels[j][i];
-            uint8_t bottom = pixels[j + 1][i];
-            set_fg(top);
-            set_bg(bottom);
-            print_half_block();
+void set_renderer(render_mode mode) {
+    renderer = mode;
+    cell_w = mode == RENDER_SEXTANT ? 2 : 1;
+    cell_h = mode == RENDER_SEXTANT ? 3 : 2;
+    full_repaint = true;
+}
+
+// Screen position (1-based) of the top-left character of the view
+uint16_t view_left() {
+    return scr_w / 2 - (PIX_W / cell_w / 2);
+}
+
+uint16_t view_top() {
+    return scr_h / 2 - (PIX_H / cell_h / 2) + 1;
+}
+
+bool cell_changed(frame_pixels src, uint8_t x, uint8_t y) {
+    for (uint8_t j = y; j < y + cell_h; j++) {
+        if (memcmp(&src[j][x], &pixels_front[j][x], cell_w) != 0) return true;
+    }
+    return false;
+}
+
+void out_pixel_cell(frame_pixels src, uint8_t x, uint8_t y) {
+    if (renderer == RENDER_SEXTANT) {
+        uint8_t px[6] = {
+            src[y][x], src[y][x + 1],
+            src[y + 1][x], src[y + 1][x + 1],
+            src[y + 2][x], src[y + 2][x + 1]
+        };
+        out_sextant(out, px);
+    } else {
+        out_cell(out, src[y][x], src[y + 1][x]);
+    }
+    for (uint8_t j = y; j < y + cell_h; j++) {
+        memcpy(&pixels_front[j][x], &src[j][x], cell_w);
+    }
+}
+
+/// If the camera moved by whole cells, scroll what's already on the terminal
+/// and shift `pixels_front` to match, so only the exposed cells get redrawn.
+/// Returns false if it couldn't (no margin support, partial cell, too far...)
+bool scroll_front(frame_pixels src, int32_t dx, int32_t dy) {
+    if (!term_margins) return false;
+    if (dx % cell_w != 0 || dy % cell_h != 0) return false;
+    if (abs(dx) >= PIX_W / 2 || abs(dy) >= PIX_H / 2) return false;
+
+    int16_t left = view_left();
+    int16_t top = view_top();
+    int16_t right = left + PIX_W / cell_w - 1;
+    int16_t bottom = top + PIX_H / cell_h - 1;
+    if (left < 1 || top < 1 || right > scr_w || bottom > scr_h) return false;
+
+    out_scroll_rect(out, left, top, right, bottom, dx / cell_w, dy / cell_h);
+
+    // Exposed cells get a value that can't match the new frame
+    static uint8_t shifted[PIX_H][PIX_W];
+    for (int16_t j = 0; j < PIX_H; j++) {
+        for (int16_t i = 0; i < PIX_W; i++) {
+            int16_t sx = i + dx;
+            int16_t sy = j + dy;
+            bool exposed = sx < 0 || sx >= PIX_W || sy < 0 || sy >= PIX_H;
+            shifted[j][i] = exposed ? ~src[j][i] : pixels_front[sy][sx];
+        }
+    }
+    memcpy(pixels_front, shifted, sizeof(pixels_front));
+    return true;
+}
+
+// Only emits the character cells that changed since the last frame.
+// Runs of unchanged cells are jumped over with a cursor move.
+void render_pixels(frame_pixels src, int32_t cam_x, int32_t cam_y) {
+    bool full = full_repaint;
+    full_repaint = false;
+    if (!full && (cam_x != front_cam_x || cam_y != front_cam_y)) {
+        scroll_front(src, cam_x - front_cam_x, cam_y - front_cam_y);
+    }
+    front_cam_x = cam_x;
+    front_cam_y = cam_y;
+
+    uint16_t left = view_left();
+    uint16_t top = view_top();
+    for (uint8_t j = 0; j + cell_h <= PIX_H; j += cell_h) {
+        uint16_t row = top + j / cell_h;
+        bool placed = false; // cursor is somewhere on this row
+        uint16_t skip = 0;
+        for (uint8_t i = 0; i + cell_w <= PIX_W; i += cell_w) {
+            if (!full && !cell_changed(src, i, j)) {
+                skip++;
+                continue;
+            }
+            if (!placed) {
+                cursor_to(left + i / cell_w, row);
+                placed = true;
+            } else if (skip > 0) {
+                cursor_fwd(skip);
+            }
+            skip = 0;
+
+            out_pixel_cell(src, i, j);
         }
     }
 }
@@ -378,202 +884,390 @@ uint8_t get_cell(uint8_t x, uint8_t y) {
     return pixels[y][x];
 }
 
-tile *get_tile(uint8_t x, uint8_t y) {
-    if (y >= TILE_ROWS || y < 0) return &bedrocked;
-    if (x >= TILE_COLS || x < 0) return &bedrocked;
-    return &tiles[y][x];
+// Outside the world is all bedrock; chunks that aren't there are all empty
+tile_type get_type(int32_t x, int32_t y) {
+    if (!in_world(x, y)) return TILE_BEDROCK;
+    chunk *c = get_chunk(x, y);
+    if (c == NULL) return TILE_EMPTY;
+    return c->types[y & CHUNK_MASK][x & CHUNK_MASK];
+}
+
+tile_data get_data(int32_t x, int32_t y) {
+    if (!in_world(x, y)) return (tile_data){0};
+    chunk *c = get_chunk(x, y);
+    if (c == NULL) return (tile_data){0};
+    return c->data[y & CHUNK_MASK][x & CHUNK_MASK];
 }
 
-bool set_tile(uint8_t x, uint8_t y, tile_type t) {
-    if (y > TILE_ROWS || y < 0) return false;
-    if (x > TILE_COLS || x < 0) return false;
-    tiles_ticked[y][x] = true;
+/// For updating a tile's data in place: only for tiles that are there
+/// (i.e. in an allocated chunk), such as the one being ticked.
+tile_data *data_ref(int32_t x, int32_t y) {
+    chunk *c = get_chunk(x, y);
+    mark_changed(c, x, y);
+    return &c->data[y & CHUNK_MASK][x & CHUNK_MASK];
+}
 
-    tiles[y][x].type = t;
-    tiles[y][x].tile_data.type = TD_TICKS;
-    tiles[y][x].tile_data.data.ticks = 0;
+bool has_dir(int32_t x, int32_t y) {
+    if (!in_world(x, y)) return false;
+    chunk *c = get_chunk(x, y);
+    if (c == NULL) return false;
+    return c->has_dir[y & CHUNK_MASK] & (1U << (x & CHUNK_MASK));
+}
 
-    return true;
+/// Returns the chunk written to, or NULL if there was nothing to write
+/// (outside the world, or emptying an already empty chunk)
+chunk *set_tile(int32_t x, int32_t y, tile_type t) {
+    if (!in_world(x, y)) return NULL;
+    chunk *c = get_chunk(x, y);
+    if (c == NULL && t == TILE_EMPTY) {
+        // Don't allocate, but the neighbours may want to move in
+        wake_around(x, y);
+        return NULL;
+    }
+    if (c == NULL) c = alloc_chunk(x, y);
+    mark_ticked(c, x, y);
+    mark_changed(c, x, y);
+
+    if (c->types[y & CHUNK_MASK][x & CHUNK_MASK] == TILE_BEAM) {
+        // Something got in the way of a laser: it needs to re-trace
+        segment b = c->data[y & CHUNK_MASK][x & CHUNK_MASK].seg;
+        wake_tile(x - b.dir.x * b.len, y - b.dir.y * b.len);
+    }
+
+    c->types[y & CHUNK_MASK][x & CHUNK_MASK] = t;
+    c->data[y & CHUNK_MASK][x & CHUNK_MASK].ticks = 0;
+    if (tile_props[t] & TP_SERIAL) world_state.far_reaching = true;
+    c->has_dir[y & CHUNK_MASK] &= ~(1U << (x & CHUNK_MASK));
+
+    wake_around(x, y);
+    return c;
 }
 
-void set_tile_and_data_dir(uint8_t x, uint8_t y, tile_type t, dir d) {
-    if (set_tile(x, y, t)) {
-        tiles[y][x].tile_data.type = TD_DIR;
-        tiles[y][x].tile_data.data.dir.x = d.x;
-        tiles[y][x].tile_data.data.dir.y = d.y;
+void set_tile_and_data_dir(int32_t x, int32_t y, tile_type t, dir d) {
+    chunk *c = set_tile(x, y, t);
+    if (c) {
+        c->data[y & CHUNK_MASK][x & CHUNK_MASK].dir = d;
+        c->has_dir[y & CHUNK_MASK] |= 1U << (x & CHUNK_MASK);
     }
 }
 
-void set_tile_and_data_ticks(uint8_t x, uint8_t y, tile_type t, int ticks) {
-    if (set_tile(x, y, t)) {
-        tiles[y][x].tile_data.data.ticks = ticks;
+void set_tile_and_data_ticks(int32_t x, int32_t y, tile_type t, int ticks) {
+    chunk *c = set_tile(x, y, t);
+    if (c) {
+        c->data[y & CHUNK_MASK][x & CHUNK_MASK].ticks = ticks;
     }
 }
 
-void move_tile(uint8_t x, uint8_t y, dir d, tile_type t) {
+void move_tile(int32_t x, int32_t y, dir d, tile_type t) {
     set_tile(x, y, TILE_EMPTY);
     set_tile(x + d.x, y + d.y, t);
 }
 
-void move_tile_dir(uint8_t x, uint8_t y, dir d, tile_type t) {
+void move_tile_dir(int32_t x, int32_t y, dir d, tile_type t) {
     set_tile(x, y, TILE_EMPTY);
     set_tile_and_data_dir(x + d.x, y + d.y, t, d);
 }
 
-bool load_level(const char* file_name, player_state *s) {
-    FILE* file = fopen(file_name, "r");
-    if (file == NULL) {
-        printf("Failed to open file %s\n", file_name);
+void place_saved_tile(int32_t x, int32_t y, uint32_t tt_idx, player_state *s) {
+    tile_type t = tt_idx < sizeof(savefile_idx) / sizeof(savefile_idx[0]) ?
+        savefile_idx[tt_idx] : TILE_EMPTY;
+    switch (t) {
+    case TILE_LASER:
+        if (tt_idx == 10) {
+            // right facing
+            set_tile_and_data_dir(x, y, t, (dir){-1,0});
+        } else {
+            // left facing
+            set_tile_and_data_dir(x, y, t, (dir){1,0});
+        }
+        break;
+    case TILE_PLAYER:
+        s->x = x;
+        s->y = y;
+        set_tile(x, y, t);
+        break;
+    case TILE_DISSOLVER:
+        set_tile_and_data_ticks(x, y, t, -1);
+        break;
+    default:
+        set_tile(x, y, t);
+    }
+}
+
+/// Ids place_saved_tile has nothing special to do for: they can be written
+/// straight into the chunks, a run at a time
+bool is_plain_saved_tile(uint32_t tt_idx) {
+    if (tt_idx >= sizeof(savefile_idx) / sizeof(savefile_idx[0])) return true;
+    tile_type t = savefile_idx[tt_idx];
+    return t != TILE_LASER && t != TILE_PLAYER && t != TILE_DISSOLVER;
+}
+
+/// Parse one CSV line of tile indices into row `y`, or only count them if
+/// `s` is NULL. Returns how many there were.
+int32_t load_level_row(const char *line, int32_t y, player_state *s) {
+    int32_t x = 0;
+    const char *p = line;
+    char *end;
+    while (true) {
+        long tt_idx = strtol(p, &end, 10);
+        if (end == p) break;
+        if (s != NULL) place_saved_tile(x, y, tt_idx, s);
+        x++;
+        for (p = end; *p == ',' || *p == ' '; p++);
+    }
+    return x;
+}
+
+// FNV-1a
+uint64_t hash_bytes(uint64_t h, const char *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)bytes[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// When set, levels load from this copy instead of the file (recordings
+// carry their level with them)
+char *level_mem = NULL;
+size_t level_len = 0;
+
+/// The world is sized to fit: as wide as the longest line, as high as the
+/// number of (non-blank) lines
+bool load_level_csv(FILE *file, const char *file_name, uint64_t level_seed, player_state *s) {
+    char *line = NULL;
+    size_t cap = 0;
+    int32_t w = 0;
+    int32_t h = 0;
+    while (getline(&line, &cap, file) > 0) {
+        int32_t n = load_level_row(line, -1, NULL);
+        if (n == 0) continue;
+        w = max(w, n);
+        h++;
+    }
+    if (!init_world(w, h, level_seed)) {
+        printf("Bad level size %dx%d in %s\n", w, h, file_name);
+        free(line);
+        fclose(file);
         return false;
     }
-    uint32_t w = TILE_COLS;
-    uint32_t h = TILE_ROWS;
-    //fscanf(file, "%d", &w);
-    //fscanf(file, "%d", &h);
-
-    uint32_t tt_idx;
-    for (uint8_t i = 0; i < h; i++) {
-        for (uint8_t j = 0; j < w; j++) {
-            fscanf(file, "%d,", &tt_idx);
-            tile_type t = savefile_idx[tt_idx];
-            switch (t) {
-            case TILE_LASER:
-                if (tt_idx == 10) {
-                    // right facing
-                    set_tile_and_data_dir(j, i, t, (dir){-1,0});
-                } else {
-                    // left facing
-                    set_tile_and_data_dir(j, i, t, (dir){1,0});
-                }
-                break;
-            case TILE_PLAYER:
-                s->x = j;
-                s->y = i;
-                set_tile(j, i, t);
-                break;
-            case TILE_DISSOLVER:
-                set_tile_and_data_ticks(j, i, t, -1);
-                break;
-            default:
-                set_tile(j, i, t);
+
+    rewind(file);
+    int32_t y = 0;
+    while (getline(&line, &cap, file) > 0) {
+        if (load_level_row(line, y, s) > 0) y++;
+    }
+    free(line);
+    fclose(file);
+    return true;
+}
+
+dir level_dirs[] = {
+    [LEVEL_DIR_RIGHT] = {1, 0},
+    [LEVEL_DIR_LEFT] = {-1, 0},
+    [LEVEL_DIR_DOWN] = {0, 1},
+    [LEVEL_DIR_UP] = {0, -1},
+};
+
+/// Runs of plain tiles go straight into the chunks (runs of nothing cost
+/// nothing), and the whole world is woken once at the end.
+bool load_level_bin(const uint8_t *bytes, size_t len, const char *file_name,
+                    uint64_t level_seed, player_state *s) {
+    level_bin lb;
+    if (!parse_level_bin(bytes, len, &lb) || !init_world(lb.w, lb.h, level_seed)) {
+        printf("Bad binary level %s\n", file_name);
+        return false;
+    }
+    size_t total = (size_t)lb.w * lb.h;
+    level_runs r = level_plane(lb.tiles, lb.tiles_len);
+    uint8_t v;
+    uint32_t n;
+    for (size_t i = 0; i < total && next_run(&r, &v, &n); i += n) {
+        n = min(n, total - i);
+        if (!is_plain_saved_tile(v)) {
+            for (size_t k = i; k < i + n; k++) {
+                place_saved_tile(k % lb.w, k / lb.w, v, s);
             }
+            continue;
+        }
+        tile_type t = v < sizeof(savefile_idx) / sizeof(savefile_idx[0]) ?
+            savefile_idx[v] : TILE_EMPTY;
+        if (t == TILE_EMPTY) continue;
+        for (size_t k = i; k < i + n;) {
+            int32_t x = k % lb.w;
+            int32_t y = k / lb.w;
+            size_t seg = min(i + n - k, (size_t)min(lb.w - x, CHUNK_SIZE - (x & CHUNK_MASK)));
+            chunk *c = alloc_chunk(x, y);
+            memset(&c->types[y & CHUNK_MASK][x & CHUNK_MASK], t, seg);
+            k += seg;
+        }
+    }
 
+    r = level_plane(lb.data, lb.data_len);
+    for (size_t i = 0; i < total && next_run(&r, &v, &n); i += n) {
+        n = min(n, total - i);
+        if (v == LEVEL_DIR_NONE || v > LEVEL_DIR_UP) continue;
+        for (size_t k = i; k < i + n; k++) {
+            tile_type t = get_type(k % lb.w, k / lb.w);
+            if (t != TILE_EMPTY) set_tile_and_data_dir(k % lb.w, k / lb.w, t, level_dirs[v]);
         }
     }
-    fclose(file);
+    wake_all();
     return true;
 }
 
-void render_tiles_to_pixels(player_state *s, bool flash) {
-    // update camera
-    /*int8_t cxo = (s->x * px_per_tile) - s->cam_x;
-    if (cxo < 0) s->cam_x--;
-    if (cxo > 0) s->cam_x++;
-    int8_t cx = s->cam_x / px_per_tile;
-    uint8_t c_rem = s->cam_x % px_per_tile;*/
+typedef struct {
+    ldtk_extent ext;
+    player_state *s;
+    bool player; // placed one already
+} ldtk_placing;
+
+void place_ldtk_cell(void *ctx, const ldtk_level *l, const ldtk_layer *layer,
+                     int32_t x, int32_t y, int32_t value) {
+    ldtk_placing *pl = ctx;
+    if (strcmp(layer->type, "IntGrid") != 0 || layer->grid_size <= 0) return;
+    x += l->world_x / layer->grid_size - pl->ext.x0;
+    y += l->world_y / layer->grid_size - pl->ext.y0;
+    if (!in_world(x, y) || value <= 0) return;
+    // With a player in more than one level, start where a converted level
+    // would: at the last one row by row, not the last one in the file
+    player_state at = *pl->s;
+    place_saved_tile(x, y, value, pl->s);
+    if ((uint32_t)value < sizeof(savefile_idx) / sizeof(savefile_idx[0]) &&
+        savefile_idx[value] == TILE_PLAYER) {
+        if (pl->player && (at.y > y || (at.y == y && at.x > x))) *pl->s = at;
+        pl->player = true;
+    }
+}
+
+/// Every level of an LDtk project, laid out as in its world, in one world.
+/// IntGrid values are the CSV ids. Two passes: one to size the world, one
+/// to fill it.
+bool load_level_ldtk(const char *bytes, size_t len, const char *file_name,
+                     uint64_t level_seed, player_state *s) {
+    char dir[LDTK_PATH_LEN];
+    ldtk_dir(file_name, dir, sizeof(dir));
+    ldtk_placing pl = { .s = s };
+    ldtk_callbacks sizing = { .ctx = &pl.ext, .level = ldtk_extend };
+    ldtk_callbacks filling = { .ctx = &pl, .cell = place_ldtk_cell };
+    if (!ldtk_parse_bytes(bytes, len, dir, 2, &sizing) || pl.ext.levels == 0 ||
+        !init_world(pl.ext.x1 - pl.ext.x0, pl.ext.y1 - pl.ext.y0, level_seed) ||
+        !ldtk_parse_bytes(bytes, len, dir, 2, &filling)) {
+        printf("Bad LDtk project %s\n", file_name);
+        return false;
+    }
+    return true;
+}
+
+/// Any format; the seed comes from the contents (and -S)
+bool load_level_bytes(const char *bytes, size_t len, const char *file_name, player_state *s) {
+    uint64_t level_seed = hash_bytes(0xCBF29CE484222325ULL, bytes, len) ^ seed;
+    if (is_level_bin(bytes, len)) {
+        return load_level_bin((const uint8_t *)bytes, len, file_name, level_seed, s);
+    }
+    if (is_ldtk(bytes, len)) {
+        return load_level_ldtk(bytes, len, file_name, level_seed, s);
+    }
+    FILE *file = fmemopen((char *)bytes, len, "r");
+    if (file == NULL) {
+        printf("Failed to read file %s\n", file_name);
+        return false;
+    }
+    return load_level_csv(file, file_name, level_seed, s);
+}
 
-    uint8_t x1 = min(TILE_COLS - SCR_TW, max(0, s->x - (SCR_TW / 2)));
-    uint8_t x2 = x1 + SCR_TW;
+/// Levels are CSV, binary (see level_bin.h) or LDtk projects (ldtk.h).
+/// Files are mapped rather than read, so a big binary level costs little
+/// more than its tiles.
+bool load_level(const char* file_name, player_state *s) {
+    if (level_mem) return load_level_bytes(level_mem, level_len, file_name, s);
+    int fd = open(file_name, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("Failed to open file %s\n", file_name);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void *bytes = st.st_size > 0 ?
+        mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (bytes == MAP_FAILED) {
+        printf("Failed to read file %s\n", file_name);
+        return false;
+    }
+    bool ok = load_level_bytes(bytes, st.st_size, file_name, s);
+    munmap(bytes, st.st_size);
+    return ok;
+}
 
-    uint8_t y1 = min(TILE_ROWS - SCR_TH, max(0, s->y - (SCR_TH / 2)));
-    uint8_t y2 = y1 + SCR_TH;
+/// Copy a tile sprite into `pixels`, clipped once for the whole tile
+void blit_sprite(const uint8_t *spr, int16_t px, int16_t py) {
+    int16_t x0 = max(0, px);
+    int16_t x1 = min(PIX_W, px + px_per_tile);
+    int16_t y0 = max(0, py);
+    int16_t y1 = min(PIX_H, py + px_per_tile);
+    if (x0 >= x1 || y0 >= y1) return;
 
-    for (uint8_t y = y1; y < y2; y++) {
-        for (uint8_t x = x1; x < x2; x++) {
-            tile *t = get_tile(x, y);
-            for (uint8_t j = 0; j < px_per_tile; j++) {
-                for (uint8_t i = 0; i < px_per_tile; i++) {
-                    int16_t xo = (x - x1) * px_per_tile + i;// + (x1 > 0 ? (3-c_rem) : 0);
-                    if (xo < 0 || xo >= PIX_W) continue;
-                    int16_t yo = (y - y1) * px_per_tile + j;
-                    if (yo < 0 || yo >= PIX_H) continue;
-
-                    uint8_t *cur = &(pixels[yo][xo]);
-                    if (flash) {
-                        *cur = 48 + (rand() % 3);
-                        continue;
-                    }
-
-                    switch (t->type) {
-                    case TILE_EMPTY:
-                        *cur = C_BLACK;
-                        break;
-                    case TILE_ROCK:
-                    case TILE_ROCK_FALLING:
-                        *cur = pal[tile_gfx[TILE_ROCK][j * 4 + i]];
-                        break;
-                    case TILE_BEDROCK:
-                        *cur = pal[tile_gfx[TILE_BEDROCK][j * 4 + i]];
-                        break;
-                    case TILE_DIAMOND:
-                    case TILE_DIAMOND_FALLING:
-                        *cur = pal[tile_gfx[TILE_DIAMOND][j * 4 + i]];
-                        break;
-                    case TILE_DISSOLVER:
-                        *cur = pal[tile_gfx[TILE_DISSOLVER][j * 4 + i]];
-                        if (t->tile_data.data.dir.x != -1) {
-                            *cur = 200 + t->tile_data.data.ticks;
-                        }
-                        break;
-                    case TILE_SAND:
-                        *cur = pal[4];
-                        if (((i+j) % 2)) *cur = 0x3a; // checkerboard
-                        break;
-                    case TILE_SANDSTONE:
-                        *cur = pal[tile_gfx[TILE_SANDSTONE][j * 4 + i]];
-                        break;
-                    case TILE_BALLOON:
-                    case TILE_BALLOON_RISING:
-                        *cur = pal[tile_gfx[TILE_BALLOON][j * 4 + i]];
-                        break;
-                    case TILE_FIREFLY:
-                        *cur = 0xc5 + (rand() % 5);
-                        if (i == 0 && j == 0) {
-                            if (t->tile_data.data.dir.x < 0) *cur = C_YELLOW;
-                            if (t->tile_data.data.dir.x > 0) *cur = C_LIGHTGREY;
-                            if (t->tile_data.data.dir.y < 0) *cur = C_BLACK;
-                            if (t->tile_data.data.dir.y > 0) *cur = C_MAROON;
-                        }
-                        break;
-                    case TILE_PLAYER:
-                        *cur = !s->dig ? pal[10] :(0xe0 + (rand() % 5));
-                        if (j == 1) {
-                            if (s->dir.x < 0) {
-                                if (i == 1 || i == 3) *cur = 0xcd;
-                            } else {
-                                if (i == 0 || i == 2) *cur = 0xcd;
-                            }
-                        }
-                        break;
-                    case TILE_PLAYER_TAIL:
-                        *cur = pal[10];
-                        break;
-                    case TILE_AMOEBA:
-                        *cur = 17 + (rand() % 5);
-                        break;
-                    case TILE_BULLET:
-                        *cur = pal[tile_gfx[TILE_BULLET][j * 4 + i]];
-                        break;
-                    case TILE_LASER:
-                        *cur = pal[tile_gfx[TILE_BULLET][j * 4 + i]];
-                        break;
-                    case TILE_BEAM:
-                        *cur = pal[tile_gfx[TILE_BEAM][j * 4 + i]];
-                        break;
-                    default:
-                        *cur = rand()%(232-196)+197;
-                        break;
-                    }
-                }
-            }
+    for (int16_t y = y0; y < y1; y++) {
+        memcpy(&pixels[y][x0], spr + (y - py) * px_per_tile + (x0 - px), x1 - x0);
+    }
+}
+
+// Where the camera wants to be: player centred, clamped to the world
+int32_t cam_target_x(player_state *s) {
+    return max(0, min(world_state.w - SCR_TW, s->x - (SCR_TW / 2))) * px_per_tile;
+}
+
+int32_t cam_target_y(player_state *s) {
+    return max(0, min(world_state.h - SCR_TH, s->y - (SCR_TH / 2))) * px_per_tile;
+}
+
+// Ease towards the target in whole character cells (a quarter of the
+// distance, at least one cell), landing exactly on it when close.
+int32_t cam_step(int32_t cam, int32_t target, uint8_t cell) {
+    int32_t d = target - cam;
+    int32_t step = max((int32_t)cell, (abs(d) / 4) / cell * cell);
+    if (abs(d) <= step) return target;
+    return d > 0 ? cam + step : cam - step;
+}
+
+void snap_camera(player_state *s) {
+    s->cam_x = cam_target_x(s);
+    s->cam_y = cam_target_y(s);
+}
+
+void render_tiles_to_pixels(player_state *s, bool flash) {
+    // update camera
+    s->cam_x = cam_step(s->cam_x, cam_target_x(s), cell_w);
+    s->cam_y = cam_step(s->cam_y, cam_target_y(s), cell_h);
+    uint8_t rem_x = s->cam_x % px_per_tile;
+    uint8_t rem_y = s->cam_y % px_per_tile;
+
+    int32_t x1 = s->cam_x / px_per_tile;
+    int32_t x2 = x1 + SCR_TW + (rem_x > 0);
+
+    int32_t y1 = s->cam_y / px_per_tile;
+    int32_t y2 = y1 + SCR_TH + (rem_y > 0);
+
+    for (int32_t y = y1; y < y2; y++) {
+        for (int32_t x = x1; x < x2; x++) {
+            const uint8_t *spr = flash ?
+                atlas[SPR_FLASH][rng_below(&fx_rng, SPR_FRAMES)] :
+                tile_sprite(get_type(x, y), get_data(x, y), s);
+            blit_sprite(spr,
+                        (x - x1) * px_per_tile - rem_x,
+                        (y - y1) * px_per_tile - rem_y);
         }
     }
 }
 
-void random_level(int8_t px, int8_t py) {
-    for (uint8_t y = 0; y < TILE_ROWS; y++) {
-        for (uint8_t x = 0; x < TILE_COLS; x++) {
-            if (x == 0 || x == TILE_COLS - 1 || y == 0 || y == TILE_ROWS -1) {
+/// Fills the whole (already sized and seeded) world
+void random_level(int32_t px, int32_t py) {
+    int32_t w = world_state.w;
+    int32_t h = world_state.h;
+    rng r = make_rng(world_state.seed, RNG_SIM);
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            if (x == 0 || x == w - 1 || y == 0 || y == h - 1) {
                 set_tile(x, y, TILE_BEDROCK);
                 continue;
             }
@@ -581,27 +1275,27 @@ void random_level(int8_t px, int8_t py) {
                 set_tile(x, y, TILE_DIAMOND);
                 continue;
             }
-            uint16_t r = rand() % 1000;
+            uint16_t n = rng_below(&r, 1000);
 
-            if (r < 800) {
+            if (n < 800) {
                 set_tile(x, y, TILE_SAND);
                 continue;
             }
-            if (r < 900) {
+            if (n < 900) {
                 set_tile(x, y, TILE_ROCK);
-                if ((rand() % 10) == 1) {
+                if (rng_below(&r, 10) == 1) {
                     set_tile(x, y, TILE_SANDSTONE);
                 }
-                if ((rand() % 10) == 1) {
+                if (rng_below(&r, 10) == 1) {
                     set_tile(x, y, TILE_BALLOON);
                 }
                 continue;
             }
-            if (r < 940) {
+            if (n < 940) {
                 set_tile_and_data_dir(x, y, TILE_FIREFLY, (dir){1,0});
                 continue;
             }
-            if (r < 970) {
+            if (n < 970) {
                 set_tile(x, y, TILE_AMOEBA);
                 continue;
             }
@@ -609,23 +1303,26 @@ void random_level(int8_t px, int8_t py) {
         }
     }
 
+    // Same density of line segments as on a default sized level
+    uint32_t scale = max(1, (w * h) / (DEFAULT_WORLD_W * DEFAULT_WORLD_H));
+
     // add some horizontal random line segments
-    uint8_t num_h = (rand() % 5) + 5;
-    for (uint8_t i = 0; i < num_h; i++) {
-        uint8_t start = rand() % TILE_COLS;
-        uint8_t len = 6;
-        uint8_t yo = (rand() % ((TILE_ROWS - 2) / 2)) * 2;
-        for (uint8_t j = start; j < start + len; j++) {
+    uint32_t num_h = (rng_below(&r, 5) + 5) * scale;
+    for (uint32_t i = 0; i < num_h; i++) {
+        int32_t start = rng_below(&r, w);
+        int32_t len = 6;
+        int32_t yo = rng_below(&r, max(1, (h - 2) / 2)) * 2;
+        for (int32_t j = start; j < start + len; j++) {
             set_tile(j, yo, TILE_BEDROCK);
         }
     }
     // add some vertical random line segments
-    uint8_t num_v = (rand() % 5) + 5;
-    for (uint8_t i = 0; i < num_v; i++) {
-        uint8_t start = rand() % TILE_ROWS;
-        uint8_t len = 5;
-        uint8_t xo = (rand() % ((TILE_COLS - 1) / 2)) * 2;
-        for (uint8_t j = start; j < start + len; j++) {
+    uint32_t num_v = (rng_below(&r, 5) + 5) * scale;
+    for (uint32_t i = 0; i < num_v; i++) {
+        int32_t start = rng_below(&r, h);
+        int32_t len = 5;
+        int32_t xo = rng_below(&r, max(1, (w - 1) / 2)) * 2;
+        for (int32_t j = start; j < start + len; j++) {
             set_tile(xo, j, TILE_BEDROCK);
         }
     }
@@ -633,46 +1330,105 @@ void random_level(int8_t px, int8_t py) {
     set_tile(px, py, TILE_PLAYER);
 }
 
-bool is_empty(uint8_t x, uint8_t y) {
-    return is_empty_tile(get_tile(x, y)->type);
+bool is_empty(int32_t x, int32_t y) {
+    return is_empty_tile(get_type(x, y));
+}
+bool is_round(int32_t x, int32_t y) {
+    return tile_is(get_type(x, y), TP_ROUND);
+}
+
+// An explosion empties its cell and turns the consumable tiles in the 3x3
+// around it into TILE_EXP (or TILE_EXP_DIAMOND); anything explodable in
+// there goes off too. Chains are a flood fill over a queue rather than
+// recursion: a cell is emptied as it's queued, so it can't be queued twice.
+// A tick queues everything that goes off during it and resolves it all at
+// the end (see tick_tiles).
+typedef struct {
+    int32_t x;
+    int32_t y;
+    bool diamond;
+    int32_t row; // of the tile that set it off, in a strip of a parallel tick
+} blast;
+
+typedef struct {
+    blast *items;
+    size_t head;
+    size_t len;
+    size_t cap;
+    bool batching; // only queue up, until end_explosions()
+} explosion_queue;
+
+explosion_queue explosions = {0};
+
+// A strip of a parallel tick queues its own, to be put back in scan order
+// at the end of the tick (see merge_blasts)
+__thread explosion_queue *strip_blasts = NULL;
+
+void push_blast(explosion_queue *q, blast b) {
+    if (q->len == q->cap) {
+        q->cap = q->cap ? q->cap * 2 : 64;
+        q->items = realloc(q->items, q->cap * sizeof(blast));
+    }
+    q->items[q->len++] = b;
 }
-bool is_round(uint8_t x, uint8_t y) {
-    return tiledefs[get_tile(x, y)->type].round;
+
+void queue_blast(int32_t x, int32_t y, bool diamond) {
+    set_tile(x, y, TILE_EMPTY);
+    push_blast(strip_blasts ? strip_blasts : &explosions, (blast){ x, y, diamond, strip_row });
 }
 
-void explode(uint8_t x, uint8_t y, bool diamond) {
-    tile_type t = get_tile(x, y)->type;
-    //set_tile_and_data_ticks(x, y, diamond ? TILE_EXP_DIAMOND : TILE_EXP, 0);
-    set_tile(x,y,TILE_EMPTY);
-    for (int8_t i = -1; i <= 1; i++) {
-        for (int8_t j = -1; j <= 1; j++) {
-            t = get_tile(x + i, y + j)->type;
-            tile_deets td = tiledefs[t];
-            if (td.explodable) {
-                explode(x + i, y + j, diamond);
-            } else if (td.consumable) {
-                set_tile_and_data_ticks(x + i, y + j, diamond ? TILE_EXP_DIAMOND : TILE_EXP, 0);
+void resolve_explosions() {
+    explosion_queue *q = &explosions;
+    while (q->head < q->len) {
+        blast b = q->items[q->head++];
+        for (int8_t i = -1; i <= 1; i++) {
+            for (int8_t j = -1; j <= 1; j++) {
+                uint16_t props = tile_props[get_type(b.x + i, b.y + j)];
+                if (props & TP_EXPLODABLE) {
+                    queue_blast(b.x + i, b.y + j, b.diamond);
+                } else if (props & TP_CONSUMABLE) {
+                    set_tile_and_data_ticks(b.x + i, b.y + j,
+                                            b.diamond ? TILE_EXP_DIAMOND : TILE_EXP, 0);
+                }
             }
         }
     }
+    q->head = 0;
+    q->len = 0;
+}
+
+/// Explosions from here to end_explosions() are resolved together, in the
+/// order they went off
+void begin_explosions() {
+    explosions.batching = true;
+}
+
+void end_explosions() {
+    explosions.batching = false;
+    resolve_explosions();
+}
+
+void explode(int32_t x, int32_t y, bool diamond) {
+    queue_blast(x, y, diamond);
+    if (!explosions.batching) resolve_explosions();
 }
 
 /// For tiles that are currently static, but can start falling
 /// if a space opens up below them
-void update_tile_fallable(uint8_t i, uint8_t j, tile_type t) {
-    tile_type dn = get_tile(i, j + 1)->type;
-    tile_deets td_dn = tiledefs[dn];
+void update_tile_fallable(int32_t i, int32_t j, tile_type t) {
+    tile_type dn = get_type(i, j + 1);
+    uint16_t props_dn = tile_props[dn];
 
     if (is_empty_tile(dn)) {
         set_tile(i, j, t);
         // Roll to the left
-    } else if (td_dn.round &&
+    } else if ((props_dn & TP_ROUND) &&
                is_empty(i - 1, j) &&
                is_empty(i - 1, j + 1)) {
         set_tile(i, j, TILE_EMPTY);
         set_tile(i - 1, j, t);
         // Roll to the right
-    } else if (td_dn.round &&
+    } else if ((props_dn & TP_ROUND) &&
                is_empty(i + 1, j) &&
                is_empty(i + 1, j + 1)) {
         set_tile(i, j, TILE_EMPTY);
@@ -680,21 +1436,21 @@ void update_tile_fallable(uint8_t i, uint8_t j, tile_type t) {
     }
 }
 
-void update_tile_shootable(uint8_t i, uint8_t j, tile *tile) {
-    if (tile->tile_data.type == TD_DIR) {
-        dir d = tile->tile_data.data.dir;
-        tile_type t = get_tile(i + d.x, j + d.y)->type;
+void update_tile_shootable(int32_t i, int32_t j) {
+    if (has_dir(i, j)) {
+        dir d = get_data(i, j).dir;
+        tile_type t = get_type(i + d.x, j + d.y);
         if (is_open_tile(t)) {
-            move_tile_dir(i, j, d, tile->type);
+            move_tile_dir(i, j, d, get_type(i, j));
         } else {
             explode(i, j, false);
         }
     }
 }
 
-void update_tile_falling(uint8_t i, uint8_t j, tile_type rest, tile_type fall) {
-    tile_type dn = get_tile(i, j + 1)->type;
-    tile_deets td_dn = tiledefs[dn];
+void update_tile_falling(int32_t i, int32_t j, tile_type rest, tile_type fall) {
+    tile_type dn = get_type(i, j + 1);
+    uint16_t props_dn = tile_props[dn];
 
     // Straight down
     if (is_empty_tile(dn)) {
@@ -702,18 +1458,18 @@ void update_tile_falling(uint8_t i, uint8_t j, tile_type rest, tile_type fall) {
         set_tile(i, j + 1, fall);
 
     // explode things
-    } else if (td_dn.explodable) {
+    } else if (props_dn & TP_EXPLODABLE) {
         explode(i, j + 1, false);
 
     // Roll to the left
-    } else if (td_dn.round &&
+    } else if ((props_dn & TP_ROUND) &&
                is_empty(i - 1, j) &&
                is_empty(i - 1, j + 1)) {
         set_tile(i, j, TILE_EMPTY);
         set_tile(i - 1, j, fall);
 
     // Roll to the right
-    } else if (td_dn.round &&
+    } else if ((props_dn & TP_ROUND) &&
                is_empty(i + 1, j) &&
                is_empty(i + 1, j + 1)) {
         set_tile(i, j, TILE_EMPTY);
@@ -723,20 +1479,20 @@ void update_tile_falling(uint8_t i, uint8_t j, tile_type rest, tile_type fall) {
     }
 }
 
-void update_tile_riseable(uint8_t i, uint8_t j, tile_type t) {
-    tile_type up = get_tile(i, j - 1)->type;
-    tile_deets td_up = tiledefs[up];
+void update_tile_riseable(int32_t i, int32_t j, tile_type t) {
+    tile_type up = get_type(i, j - 1);
+    uint16_t props_up = tile_props[up];
 
     if (up == TILE_EMPTY) {
         set_tile(i, j, t);
         // Roll to the left
-    } else if (td_up.round &&
+    } else if ((props_up & TP_ROUND) &&
                is_empty(i - 1, j) &&
                is_empty(i - 1, j - 1)) {
         set_tile(i, j, TILE_EMPTY);
         set_tile(i - 1, j, t);
         // Roll to the right
-    } else if (td_up.round &&
+    } else if ((props_up & TP_ROUND) &&
                is_empty(i + 1, j) &&
                is_empty(i + 1, j - 1)) {
         set_tile(i, j, TILE_EMPTY);
@@ -744,9 +1500,9 @@ void update_tile_riseable(uint8_t i, uint8_t j, tile_type t) {
     }
 }
 
-void update_tile_rising(uint8_t i, uint8_t j, tile_type rest, tile_type rise) {
-    tile_type up = get_tile(i, j - 1)->type;
-    tile_deets td_up = tiledefs[up];
+void update_tile_rising(int32_t i, int32_t j, tile_type rest, tile_type rise) {
+    tile_type up = get_type(i, j - 1);
+    uint16_t props_up = tile_props[up];
 
     // Straight up
     if (up == TILE_EMPTY) {
@@ -754,18 +1510,18 @@ void update_tile_rising(uint8_t i, uint8_t j, tile_type rest, tile_type rise) {
         set_tile(i, j - 1, rise);
 
     // explode things
-    } else if (td_up.explodable) {
+    } else if (props_up & TP_EXPLODABLE) {
         explode(i, j - 1, false);
 
     // Rise to the left
-    } else if (td_up.round &&
+    } else if ((props_up & TP_ROUND) &&
                is_empty(i - 1, j) &&
                is_empty(i - 1, j - 1)) {
         set_tile(i, j, TILE_EMPTY);
         set_tile(i - 1, j, rise);
 
     // Roll to the right
-    } else if (td_up.round &&
+    } else if ((props_up & TP_ROUND) &&
                is_empty(i + 1, j) &&
                is_empty(i + 1, j - 1)) {
         set_tile(i, j, TILE_EMPTY);
@@ -776,12 +1532,12 @@ void update_tile_rising(uint8_t i, uint8_t j, tile_type rest, tile_type rise) {
 
 }
 
-void push_block(uint8_t x, uint8_t y, player_state *s, tile_type ot) {
+void push_block(int32_t x, int32_t y, player_state *s, tile_type ot) {
     int8_t dx = s->dx;
     int8_t dy = s->dy;
     bool dig = s->dig;
 
-    tile_type t = get_tile(x + dx * 2, y + dy * 2)->type;
+    tile_type t = get_type(x + dx * 2, y + dy * 2);
     if (is_open_tile(t)) {
         if (dig) {
             set_tile_and_data_dir(x + dx * 2, y + dy * 2, ot, (dir){dx, dy});
@@ -798,23 +1554,22 @@ void push_block(uint8_t x, uint8_t y, player_state *s, tile_type ot) {
     }
 }
 
-void update_player(uint8_t x, uint8_t y, player_state *s) {
+void update_player(int32_t x, int32_t y, player_state *s) {
     int8_t dx = s->dx;
     int8_t dy = s->dy;
     bool dig = s->dig;
     s->moved = false;
     s->got_diamond = false;
 
-    uint8_t old_x = s->x;
-    uint8_t old_y = s->y;
+    int32_t old_x = s->x;
+    int32_t old_y = s->y;
 
     /*if (dx != 0) s->facing_right = true;
       if (dx < 0) s->facing_right = false;*/
 
     bool pushing = dx != 0 || dy != 0;
 
-    tile_type t = get_tile(x + s->dx, y + s->dy)->type;
-    tile_deets td = tiledefs[t];
+    tile_type t = get_type(x + s->dx, y + s->dy);
 
     if (is_open_tile(t)) {
         if (dig) {
@@ -848,7 +1603,7 @@ void update_player(uint8_t x, uint8_t y, player_state *s) {
             s->y = y + dy;
         }
         s->got_diamond = true;
-    } else if (pushing && td.pushable) {
+    } else if (pushing && tile_is(t, TP_PUSHABLE)) {
         push_block(x, y, s, t);
     }
     if (old_x != s->x || old_y != s->y) {
@@ -870,30 +1625,30 @@ dir rotate_right(dir *d) {
     return (dir){ 0, -1 };
 }
 
-void update_firefly(uint8_t x, uint8_t y, dir *d) {
+void update_firefly(int32_t x, int32_t y, dir *d) {
     // if touching player - explode
-    if (is_player(get_tile(x, y - 1)->type) ||
-        is_player(get_tile(x, y + 1)->type) ||
-        is_player(get_tile(x - 1, y)->type) ||
-        is_player(get_tile(x + 1, y)->type)) {
+    if (is_player(get_type(x, y - 1)) ||
+        is_player(get_type(x, y + 1)) ||
+        is_player(get_type(x - 1, y)) ||
+        is_player(get_type(x + 1, y))) {
         explode(x, y, false);
         return;
     }
 
-    if (get_tile(x, y - 1)->type == TILE_AMOEBA ||
-        get_tile(x, y + 1)->type == TILE_AMOEBA ||
-        get_tile(x - 1, y)->type == TILE_AMOEBA ||
-        get_tile(x + 1, y)->type == TILE_AMOEBA) {
+    if (get_type(x, y - 1) == TILE_AMOEBA ||
+        get_type(x, y + 1) == TILE_AMOEBA ||
+        get_type(x - 1, y) == TILE_AMOEBA ||
+        get_type(x + 1, y) == TILE_AMOEBA) {
         explode(x, y, true);
         return;
     }
 
     // Try rotate left
     dir rotL = rotate_left(d);
-    if (get_tile(x + rotL.x, y + rotL.y)->type == TILE_EMPTY) {
+    if (get_type(x + rotL.x, y + rotL.y) == TILE_EMPTY) {
         // small chance to not turn left even if can
         // stops endless loop
-        if (rand()%20>0) {
+        if (cell_rand(x, y)%20>0) {
             d->x = rotL.x;
             d->y = rotL.y;
             move_tile_dir(x, y, *d, TILE_FIREFLY);
@@ -902,7 +1657,7 @@ void update_firefly(uint8_t x, uint8_t y, dir *d) {
     }
 
     // Try go straight
-    if (get_tile(x + d->x, y + d->y)->type == TILE_EMPTY) {
+    if (get_type(x + d->x, y + d->y) == TILE_EMPTY) {
         move_tile_dir(x, y, *d, TILE_FIREFLY);
         return;
     }
@@ -914,167 +1669,1267 @@ void update_firefly(uint8_t x, uint8_t y, dir *d) {
     set_tile_and_data_dir(x, y, TILE_FIREFLY, *d);
 }
 
-void update_amoeba(uint8_t x, uint8_t y) {
-    // NOTE: not doing growing.
-    if (true || rand()%250 != 0) {
+void update_amoeba(int32_t x, int32_t y) {
+    // NOTE: not doing growing. (Amoeba sleeps like any passive tile: growing
+    // would need TP_ACTIVE back in TILE_TYPES.)
+    if (true || cell_rand(x, y)%250 != 0) {
         return;
     }
-    uint8_t di = rand() % 4;
+    uint8_t di = cell_rand(x, y) / 250 % 4;
     uint8_t dx[] = { -1, 1, 0, 0 };
     uint8_t dy[] = { 0, 0, -1, 1 };
     dir d = { dx[di], dy[di] };
-    if (is_open_tile(get_tile(x + d.x, y + d.y)->type)) {
+    if (is_open_tile(get_type(x + d.x, y + d.y))) {
         set_tile(x + d.x, y + d.y, TILE_AMOEBA);
     }
 }
 
-void update_dissolver(uint8_t x, uint8_t y, tile *t) {
+void update_dissolver(int32_t x, int32_t y) {
+    tile_data *t = data_ref(x, y);
     // if thing is alive, start crumbling.
-    if (t->tile_data.data.ticks >= 0) {
-        if (t->tile_data.data.ticks-- <= 0) {
+    if (t->ticks >= 0) {
+        if (t->ticks-- <= 0) {
             set_tile(x, y, TILE_EMPTY);
         }
         return;
     }
 
     // Should we start dissolving?
-    if (is_player(get_tile(x, y - 1)->type) ||
-        is_player(get_tile(x, y + 1)->type) ||
-        is_player(get_tile(x - 1, y)->type) ||
-        is_player(get_tile(x + 1, y)->type)) {
-        t->tile_data.data.ticks = 5;
+    if (is_player(get_type(x, y - 1)) ||
+        is_player(get_type(x, y + 1)) ||
+        is_player(get_type(x - 1, y)) ||
+        is_player(get_type(x + 1, y))) {
+        t->ticks = 5;
         return;
     }
 }
 
-void update_laser(uint8_t x, uint8_t y, dir *d) {
-    int8_t xo = d->x;
-    int8_t yo = d->y;
+// A laser's beam stays put between ticks. The laser only re-traces it when
+// woken: by a change right next to it, by set_tile overwriting one of its
+// beam cells, or by its last beam cell seeing the way ahead open up.
+
+bool is_own_beam(int32_t x, int32_t y, dir d, uint32_t dist) {
+    if (get_type(x, y) != TILE_BEAM) return false;
+    segment b = get_data(x, y).seg;
+    return b.dir.x == d.x && b.dir.y == d.y && b.len == dist;
+}
+
+void set_beam(int32_t x, int32_t y, dir d, uint16_t dist) {
+    chunk *c = set_tile(x, y, TILE_BEAM);
+    if (c) {
+        c->data[y & CHUNK_MASK][x & CHUNK_MASK].seg = (segment){ d, dist };
+    }
+}
+
+/// Re-trace the beam, only writing the cells that changed. Returns true if
+/// it hit something (and so should look again next tick).
+bool update_laser(int32_t x, int32_t y) {
+    segment *seg = &data_ref(x, y)->seg;
+    dir d = seg->dir;
+    uint32_t old_len = seg->len;
+    uint32_t len = 0;
     bool hit = false;
-    while (!hit) {
-        tile_type t = get_tile(x + xo, y + yo)->type;
-        tile_deets td = tiledefs[t];
+    while (len < UINT16_MAX) {
+        int32_t bx = x + d.x * (len + 1);
+        int32_t by = y + d.y * (len + 1);
+        tile_type t = get_type(bx, by);
         if (is_open_tile(t)) {
-            set_tile(x + xo, y + yo, TILE_BEAM);
-            xo += d->x;
-            yo += d->y;
-        } else {
+            if (!is_own_beam(bx, by, d, len + 1)) set_beam(bx, by, d, len + 1);
+            len++;
+            continue;
+        }
+        if (tile_is(t, TP_EXPLODABLE)) {
+            explode(bx, by, true);
+            set_beam(bx, by, d, len + 1);
+            len++;
             hit = true;
-            if (td.explodable) {
-                explode(x + xo, y + yo, true);
-                set_tile(x + xo, y + yo, TILE_BEAM);
-            }
         }
+        break;
     }
-}
-
-void reset_ticked() {
-    memset(tiles_ticked, false, TILE_COLS * TILE_ROWS);
-}
-
-void tick_tiles(player_state *s) {
-    reset_ticked();
-    for (int8_t j = TILE_ROWS-1; j >= 0; j--) {
-        for (uint8_t i = 0; i < TILE_COLS; i++) {
-            // Only process each cell once per tick
-            if (tiles_ticked[j][i]) continue;
-
-            tile *tile = get_tile(i, j);
-            uint8_t t= tile->type;
-
-            if (t == TILE_EMPTY || t == TILE_BEDROCK || t == TILE_SAND) continue;
-
-            switch (t) {
-            case TILE_BULLET:
-                update_tile_shootable(i, j, tile);
-                break;
-            case TILE_ROCK:
-                update_tile_fallable(i, j, TILE_ROCK_FALLING);
-                update_tile_shootable(i, j, tile);
-                break;
-            case TILE_ROCK_FALLING:
-                update_tile_falling(i, j, TILE_ROCK, TILE_ROCK_FALLING);
-                break;
-            case TILE_DIAMOND:
-                update_tile_fallable(i, j, TILE_DIAMOND_FALLING);
-                break;
-            case TILE_DIAMOND_FALLING:
-                update_tile_falling(i, j, TILE_DIAMOND, TILE_DIAMOND_FALLING);
-                break;
-            case TILE_SANDSTONE:
-                update_tile_shootable(i, j, tile);
-                break;
-            case TILE_BALLOON:
-                update_tile_riseable(i, j, TILE_BALLOON_RISING);
-                break;
-            case TILE_BALLOON_RISING:
-                update_tile_rising(i, j, TILE_BALLOON, TILE_BALLOON_RISING);
-                break;
-            case TILE_PLAYER:
-                update_player(i, j, s);
-                if (s->got_diamond) {
-                    s->lives += 16;
-                }
-                if (s->moved) {
-                    s->lives -= 1;
-                }
-                break;
-            case TILE_PLAYER_TAIL:
-                if (tile->tile_data.data.ticks <= s->tail - 2) {
-                    set_tile(i, j, TILE_EMPTY);
-                }
-                break;
-            case TILE_EXP:
-                if (tile->tile_data.data.ticks++ > 4) {
-                    set_tile(i, j, TILE_EMPTY);
-                }
-                break;
-            case TILE_EXP_DIAMOND:
-                if (tile->tile_data.data.ticks++ > 4) {
-                    set_tile(i, j, TILE_DIAMOND);
-                }
-                break;
-            case TILE_FIREFLY: update_firefly(i, j, &tile->tile_data.data.dir); break;
-            case TILE_AMOEBA: update_amoeba(i, j); break;
-            case TILE_DISSOLVER: update_dissolver(i, j, tile); break;
-            case TILE_LASER:
-                update_laser(i, j, &tile->tile_data.data.dir);
-                break;
-            case TILE_BEAM:
-                // Beams are "active" - they are updated every frame by the laser.
-                // So if we get here, we are at an unticked tile: which means it WASN'T
-                // drawn by the laser this frame... so it is blocked by something and we can erase it
-                set_tile(i, j, TILE_EMPTY);
-            default:
-                break;
-            }
+    // Switch off whatever is past the new end
+    for (uint32_t k = len + 1; k <= old_len; k++) {
+        if (is_own_beam(x + d.x * k, y + d.y * k, d, k)) {
+            set_tile(x + d.x * k, y + d.y * k, TILE_EMPTY);
         }
     }
+    seg->len = len;
+    return hit;
 }
 
-void bg_fill() {
-    set_bg(C_BLACK);
-    for (int j = 0; j <= scr_h; j++) {
-        for (int i = 0; i <= scr_w; i++) {
-            cursor_to(i, j);
-            if (rand() % 30 == 0) {
-                // Star
-                set_fg((rand() % 20) + 232);
-                printf(".");
-            } else {
-                // Empty
-                printf(" ");
-            }
+/// Beam cells only get updated when something next to them changed
+void update_beam(int32_t x, int32_t y) {
+    segment b = get_data(x, y).seg;
+    int32_t lx = x - b.dir.x * b.len;
+    int32_t ly = y - b.dir.y * b.len;
+    segment laser = get_data(lx, ly).seg;
+    if (get_type(lx, ly) != TILE_LASER || laser.len < b.len ||
+        laser.dir.x != b.dir.x || laser.dir.y != b.dir.y) {
+        // left behind by a laser that's gone
+        set_tile(x, y, TILE_EMPTY);
+        return;
+    }
+    if (b.len == laser.len) {
+        // the end: if whatever stopped the beam moved, the laser can go on
+        tile_type ahead = get_type(x + b.dir.x, y + b.dir.y);
+        if (tile_is(ahead, TP_OPEN | TP_EXPLODABLE)) {
+            wake_tile(lx, ly);
         }
     }
 }
 
-void done(int signum) {
-    esc("?25h"); // show cursor
-    esc("0m"); // reset fg/bg
-    init_ansi_keys(false);
+void reset_ticked() {
+    world_state.tick_gen++;
+}
+
+/// Tiles that change by themselves, so stay awake even if nothing around
+/// them does. Everything else sleeps until set_tile wakes it.
+bool is_active_tile(int32_t x, int32_t y) {
+    tile_type t = get_type(x, y);
+    uint16_t props = tile_props[t];
+    if (props & TP_ACTIVE) return true;
+    if (props & TP_FLIES) return has_dir(x, y); // pushed with dig: flying
+    if (props & TP_CRUMBLES) return get_data(x, y).ticks >= 0;
+    return false;
+}
+
+// The update for each tile type that has one (see TILE_TYPES)
+
+void tick_shootable(int32_t i, int32_t j, player_state *s) {
+    update_tile_shootable(i, j);
+}
+
+void tick_rock(int32_t i, int32_t j, player_state *s) {
+    update_tile_fallable(i, j, TILE_ROCK_FALLING);
+    update_tile_shootable(i, j);
+}
+
+void tick_rock_falling(int32_t i, int32_t j, player_state *s) {
+    update_tile_falling(i, j, TILE_ROCK, TILE_ROCK_FALLING);
+}
+
+void tick_diamond(int32_t i, int32_t j, player_state *s) {
+    update_tile_fallable(i, j, TILE_DIAMOND_FALLING);
+}
+
+void tick_diamond_falling(int32_t i, int32_t j, player_state *s) {
+    update_tile_falling(i, j, TILE_DIAMOND, TILE_DIAMOND_FALLING);
+}
+
+void tick_balloon(int32_t i, int32_t j, player_state *s) {
+    update_tile_riseable(i, j, TILE_BALLOON_RISING);
+}
+
+void tick_balloon_rising(int32_t i, int32_t j, player_state *s) {
+    update_tile_rising(i, j, TILE_BALLOON, TILE_BALLOON_RISING);
+}
+
+void tick_player(int32_t i, int32_t j, player_state *s) {
+    update_player(i, j, s);
+    if (s->got_diamond) {
+        s->lives += 16;
+    }
+    if (s->moved) {
+        s->lives -= 1;
+    }
+}
+
+void tick_player_tail(int32_t i, int32_t j, player_state *s) {
+    if (get_data(i, j).ticks <= s->tail - 2) {
+        set_tile(i, j, TILE_EMPTY);
+    }
+}
+
+void tick_exp(int32_t i, int32_t j, player_state *s) {
+    if (data_ref(i, j)->ticks++ > 4) {
+        set_tile(i, j, TILE_EMPTY);
+    }
+}
+
+void tick_exp_diamond(int32_t i, int32_t j, player_state *s) {
+    if (data_ref(i, j)->ticks++ > 4) {
+        set_tile(i, j, TILE_DIAMOND);
+    }
+}
+
+void tick_firefly(int32_t i, int32_t j, player_state *s) {
+    update_firefly(i, j, &data_ref(i, j)->dir);
+}
+
+void tick_amoeba(int32_t i, int32_t j, player_state *s) {
+    update_amoeba(i, j);
+}
+
+void tick_dissolver(int32_t i, int32_t j, player_state *s) {
+    update_dissolver(i, j);
+}
+
+void tick_laser(int32_t i, int32_t j, player_state *s) {
+    // Having just traced the beam, there's nothing to do until something
+    // changes (its own writes will have woken it)
+    if (update_laser(i, j)) {
+        wake_tile(i, j);
+    } else {
+        sleep_tile(i, j);
+    }
+}
+
+void tick_beam(int32_t i, int32_t j, player_state *s) {
+    update_beam(i, j);
+}
+
+typedef void (*tile_update)(int32_t i, int32_t j, player_state *s);
+
+#define TILE_UPDATE(name, update, sprite, look, props) [TILE_##name] = update,
+const tile_update tile_updates[TILE__LEN] = { TILE_TYPES(TILE_UPDATE) };
+
+/// Update one awake tile
+void tick_tile(int32_t i, int32_t j, player_state *s) {
+    // Only process each cell once per tick
+    if (is_ticked(i, j)) return;
+
+    tile_type t = get_type(i, j);
+
+    // Off to sleep, unless it changes something (set_tile wakes it)
+    // or keeps itself busy (checked after the update)
+    sleep_tile(i, j);
+
+    tile_update update = tile_updates[t];
+    if (update == NULL) return; // inert
+
+    update(i, j, s);
+
+    if (is_active_tile(i, j)) wake_tile(i, j);
+}
+
+/// Update the awake tiles in columns [x0, x1) of row `j`, left to right.
+/// Tiles woken further along still get visited, just like a full scan would.
+void tick_span(int32_t j, int32_t x0, int32_t x1, player_state *s) {
+    for (int32_t i = next_awake(j, x0, x1); i >= 0; i = next_awake(j, i + 1, x1)) {
+        tick_tile(i, j, s);
+    }
+}
+
+/// Update the awake tiles in rows [y0, y1), bottom to top
+void tick_rows(int32_t y0, int32_t y1, player_state *s) {
+    for (int32_t j = y1 - 1; j >= y0; j--) {
+        tick_span(j, 0, world_state.w, s);
+    }
+}
+
+// ============= Parallel ticks ==================
+
+// With -j, the world is cut into strips of whole chunk columns, one per
+// thread, and each thread scans its strip bottom to top as tick_rows would.
+// Nothing a tile does reaches further than STRIP_REACH, so only the columns
+// along a strip's edges can touch its neighbours', and those are kept in the
+// order of a single scan: a strip starts a row (its left edge) once the strip
+// to its left has finished it, and finishes it (its right edge) once the
+// strip to its right has done the left edge of the row below. The middles
+// run freely, so the strips move up the world in a staggered line. Each
+// strip queues its own explosions, merged back into scan order at the end.
+// The result is the same as tick_rows', on any number of threads.
+//
+// Lasers and their beams (TP_SERIAL) reach across the world: a world that
+// has had any ticks on one thread. The player and its tail share
+// player_state, which works as they're never more than two tiles apart.
+#define STRIP_REACH 3 // a push writes two tiles away, and wakes around that
+// The edge columns: those whose updates can reach a neighbour's, and the
+// rest of the chunk, as its bit masks are shared
+#define STRIP_EDGE (CHUNK_SIZE + STRIP_REACH)
+#define STRIP_MIN_CHUNKS 4 // so a strip is wider than its two edges
+
+typedef struct {
+    int32_t x0;             // columns [x0, x1)
+    int32_t x1;
+    uint32_t left_rows;     // rows, from the bottom, with their left edge done
+    uint32_t done_rows;     // rows all done
+    explosion_queue blasts; // set off in this strip this tick
+    size_t merged;          // of `blasts`, back in the main queue
+} strip;
+
+typedef struct {
+    int threads;            // 0: single scan
+    pthread_t *workers;     // threads - 1: the ticking thread is the other
+    pthread_mutex_t lock;
+    pthread_cond_t go;
+    pthread_cond_t done;
+    uint32_t job;           // bumped to start each tick
+    int busy;               // workers still on the current tick
+    int32_t next_strip;     // claimed with an atomic add
+    int32_t num_strips;
+    strip *strips;          // one per thread, at most
+    player_state *s;
+    bool quit;
+} tick_pool;
+
+tick_pool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .go = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER
+};
+
+/// Wait for a neighbouring strip to get `n` rows along. They keep in step,
+/// so it's short; yield in case there are more threads than cores.
+void wait_rows(uint32_t *rows, uint32_t n) {
+    for (int spins = 0; __atomic_load_n(rows, __ATOMIC_ACQUIRE) < n; spins++) {
+        if (spins >= 64) sched_yield();
+    }
+}
+
+void tick_strip(tick_pool *p, int32_t k) {
+    strip *st = &p->strips[k];
+    strip *left = k > 0 ? &p->strips[k - 1] : NULL;
+    strip *right = k + 1 < p->num_strips ? &p->strips[k + 1] : NULL;
+    int32_t mid0 = st->x0 + STRIP_EDGE;
+    int32_t mid1 = st->x1 - STRIP_EDGE;
+    strip_blasts = &st->blasts;
+    for (uint32_t n = 0; n < (uint32_t)world_state.h; n++) {
+        int32_t j = world_state.h - 1 - n;
+        strip_row = j;
+        if (left) wait_rows(&left->done_rows, n + 1);
+        tick_span(j, st->x0, mid0, p->s);
+        __atomic_store_n(&st->left_rows, n + 1, __ATOMIC_RELEASE);
+        tick_span(j, mid0, mid1, p->s);
+        if (right) wait_rows(&right->left_rows, n);
+        tick_span(j, mid1, st->x1, p->s);
+        __atomic_store_n(&st->done_rows, n + 1, __ATOMIC_RELEASE);
+    }
+    strip_row = -1;
+    strip_blasts = NULL;
+}
+
+void run_strips(tick_pool *p) {
+    while (true) {
+        int32_t k = __atomic_fetch_add(&p->next_strip, 1, __ATOMIC_RELAXED);
+        if (k >= p->num_strips) break;
+        tick_strip(p, k);
+    }
+}
+
+void *tick_worker(void *arg) {
+    tick_pool *p = (tick_pool *)arg;
+    uint32_t seen = 0;
+    pthread_mutex_lock(&p->lock);
+    while (true) {
+        while (!p->quit && p->job == seen) {
+            pthread_cond_wait(&p->go, &p->lock);
+        }
+        if (p->quit) break;
+        seen = p->job;
+        pthread_mutex_unlock(&p->lock);
+
+        run_strips(p);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0) pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+void start_tick_pool(int threads) {
+    pool.threads = threads;
+    pool.workers = calloc(threads, sizeof(pthread_t));
+    pool.strips = calloc(threads, sizeof(strip));
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_create(&pool.workers[i], NULL, tick_worker, &pool);
+    }
+}
+
+void stop_tick_pool() {
+    if (pool.threads == 0) return;
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.go);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.threads - 1; i++) {
+        pthread_join(pool.workers[i], NULL);
+    }
+    for (int i = 0; i < pool.threads; i++) {
+        free(pool.strips[i].blasts.items);
+    }
+    free(pool.strips);
+    free(pool.workers);
+}
+
+/// Cut the world into as many strips as there are threads and it's wide
+/// enough for. Returns how many: under 2, tick it on this thread instead.
+int32_t plan_strips(tick_pool *p) {
+    world *wd = &world_state;
+    int32_t n = min(p->threads, wd->cols / STRIP_MIN_CHUNKS);
+    if (wd->far_reaching || n < 2) return 0;
+    for (int32_t k = 0; k < n; k++) {
+        strip *st = &p->strips[k];
+        st->x0 = (wd->cols * k / n) << CHUNK_BITS;
+        st->x1 = k == n - 1 ? wd->w : (wd->cols * (k + 1) / n) << CHUNK_BITS;
+        st->left_rows = 0;
+        st->done_rows = 0;
+        st->blasts.len = 0;
+        st->merged = 0;
+    }
+    p->num_strips = n;
+    return n;
+}
+
+/// Put the strips' explosions in the main queue in the order one scan would
+/// have set them off: bottom row first, and left to right along a row
+void merge_blasts(tick_pool *p) {
+    for (int32_t j = world_state.h - 1; j >= 0; j--) {
+        for (int32_t k = 0; k < p->num_strips; k++) {
+            strip *st = &p->strips[k];
+            while (st->merged < st->blasts.len && st->blasts.items[st->merged].row == j) {
+                push_blast(&explosions, st->blasts.items[st->merged++]);
+            }
+        }
+    }
+}
+
+void tick_strips(tick_pool *p, player_state *s) {
+    p->s = s;
+    pthread_mutex_lock(&p->lock);
+    p->next_strip = 0;
+    p->busy = p->threads - 1;
+    p->job++;
+    pthread_cond_broadcast(&p->go);
+    pthread_mutex_unlock(&p->lock);
+
+    run_strips(p);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    merge_blasts(p);
+}
+
+// ======================================
+
+/// Either way, the tick's explosions go off together once it's done
+void tick_tiles(player_state *s) {
+    reset_ticked();
+    begin_explosions();
+    if (plan_strips(&pool) > 1) {
+        tick_strips(&pool, s);
+    } else {
+        tick_rows(0, world_state.h, s);
+    }
+    end_explosions();
+}
+
+// ============= Rewind ==================
+
+// Up to the last minute of play, to step back through: a full copy of the
+// world every REWIND_KEY_TICKS ticks, and in between only the tiles each
+// tick changed (see mark_changed). Keyframes and changes both count towards
+// the byte budget; a tick's changes have no size limit of their own, so
+// while it's over, the oldest keyframe goes along with the changes built
+// on it. A busy or big world keeps less than a minute.
+#define REWIND_KEY_TICKS 64
+#define REWIND_SECS 60
+#define DEFAULT_REWIND_MB 32
+
+typedef struct {
+    uint32_t index; // in world_state.chunks
+    uint8_t types[CHUNK_SIZE][CHUNK_SIZE];
+    tile_data data[CHUNK_SIZE][CHUNK_SIZE];
+    uint32_t has_dir[CHUNK_SIZE];
+} chunk_copy;
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+    uint8_t type;
+    bool has_dir;
+    tile_data data;
+} tile_change;
+
+// The world as of the end of a tick
+typedef struct {
+    player_state player;
+    uint32_t tick_gen;
+    chunk_copy *chunks;   // a keyframe: every allocated chunk, in order
+    tile_change *changes; // otherwise, what changed since the tick before
+    uint32_t len;
+    size_t bytes;
+} snapshot;
+
+typedef struct {
+    snapshot *ring; // one per tick, oldest (always a keyframe) at `head`
+    uint32_t cap;
+    uint32_t head;
+    uint32_t len;
+    uint32_t since_key;
+    size_t bytes;
+    size_t max_bytes; // 0: no rewinding
+} rewind_buffer;
+
+rewind_buffer rewind_state = {0};
+
+void init_rewind(size_t max_bytes, uint32_t ticks) {
+    rewind_buffer *rb = &rewind_state;
+    rb->ring = calloc(max(ticks, 1), sizeof(snapshot));
+    rb->cap = max(ticks, 1);
+    rb->max_bytes = rb->ring ? max_bytes : 0;
+}
+
+snapshot *nth_snapshot(rewind_buffer *rb, uint32_t i) {
+    return &rb->ring[(rb->head + i) % rb->cap];
+}
+
+void free_snapshot(snapshot *f) {
+    free(f->chunks);
+    free(f->changes);
+    *f = (snapshot){0};
+}
+
+/// Start tracking changes afresh
+void clear_changed() {
+    world *wd = &world_state;
+    for (uint32_t i = 0; i < wd->num_changed; i++) {
+        chunk *c = wd->chunks[wd->changed_chunks[i]];
+        memset(c->changed, 0, sizeof(c->changed));
+        c->listed = false;
+    }
+    wd->num_changed = 0;
+}
+
+void take_keyframe(snapshot *f, player_state *s) {
+    world *wd = &world_state;
+    f->chunks = malloc(max(wd->num_chunks, 1) * sizeof(chunk_copy));
+    f->len = 0;
+    for (uint32_t i = 0; f->chunks && i < (uint32_t)(wd->cols * wd->rows); i++) {
+        chunk *c = wd->chunks[i];
+        if (c == NULL) continue;
+        chunk_copy *cc = &f->chunks[f->len++];
+        cc->index = i;
+        memcpy(cc->types, c->types, sizeof(c->types));
+        memcpy(cc->data, c->data, sizeof(c->data));
+        memcpy(cc->has_dir, c->has_dir, sizeof(c->has_dir));
+    }
+    f->player = *s;
+    f->tick_gen = wd->tick_gen;
+    f->bytes = sizeof(snapshot) + f->len * sizeof(chunk_copy);
+    clear_changed();
+}
+
+/// Only visits the chunks that had something change
+void take_changes(snapshot *f, player_state *s) {
+    world *wd = &world_state;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < wd->num_changed; i++) {
+        chunk *c = wd->chunks[wd->changed_chunks[i]];
+        for (int32_t r = 0; r < CHUNK_SIZE; r++) {
+            n += __builtin_popcount(c->changed[r]);
+        }
+    }
+    f->changes = malloc(max(n, 1) * sizeof(tile_change));
+    f->len = 0;
+    for (uint32_t i = 0; f->changes && i < wd->num_changed; i++) {
+        uint32_t index = wd->changed_chunks[i];
+        chunk *c = wd->chunks[index];
+        for (int32_t r = 0; r < CHUNK_SIZE; r++) {
+            for (uint32_t bits = c->changed[r]; bits; bits &= bits - 1) {
+                int32_t x = __builtin_ctz(bits);
+                f->changes[f->len++] = (tile_change){
+                    .x = (index % wd->cols) * CHUNK_SIZE + x,
+                    .y = (index / wd->cols) * CHUNK_SIZE + r,
+                    .type = c->types[r][x],
+                    .has_dir = (c->has_dir[r] >> x) & 1,
+                    .data = c->data[r][x],
+                };
+            }
+        }
+    }
+    f->player = *s;
+    f->tick_gen = wd->tick_gen;
+    f->bytes = sizeof(snapshot) + f->len * sizeof(tile_change);
+    clear_changed();
+}
+
+/// Put back a keyframe's chunks; any allocated since are emptied
+void restore_chunks(snapshot *f) {
+    world *wd = &world_state;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < (uint32_t)(wd->cols * wd->rows); i++) {
+        chunk *c = wd->chunks[i];
+        if (k < f->len && f->chunks[k].index == i) {
+            chunk_copy *cc = &f->chunks[k++];
+            if (c == NULL) {
+                c = alloc_chunk((i % wd->cols) << CHUNK_BITS, (i / wd->cols) << CHUNK_BITS);
+            }
+            memcpy(c->types, cc->types, sizeof(c->types));
+            memcpy(c->data, cc->data, sizeof(c->data));
+            memcpy(c->has_dir, cc->has_dir, sizeof(c->has_dir));
+            for (int32_t r = 0; r < CHUNK_SIZE && !wd->far_reaching; r++) {
+                for (int32_t x = 0; x < CHUNK_SIZE; x++) {
+                    if (tile_props[c->types[r][x]] & TP_SERIAL) wd->far_reaching = true;
+                }
+            }
+        } else if (c != NULL) {
+            memset(c->types, 0, sizeof(c->types));
+            memset(c->data, 0, sizeof(c->data));
+            memset(c->has_dir, 0, sizeof(c->has_dir));
+        }
+    }
+}
+
+void restore_changes(snapshot *f) {
+    for (uint32_t i = 0; i < f->len; i++) {
+        tile_change *tc = &f->changes[i];
+        chunk *c = alloc_chunk(tc->x, tc->y);
+        uint32_t bit = 1U << (tc->x & CHUNK_MASK);
+        c->types[tc->y & CHUNK_MASK][tc->x & CHUNK_MASK] = tc->type;
+        if (tile_props[tc->type] & TP_SERIAL) world_state.far_reaching = true;
+        c->data[tc->y & CHUNK_MASK][tc->x & CHUNK_MASK] = tc->data;
+        c->has_dir[tc->y & CHUNK_MASK] = tc->has_dir ?
+            c->has_dir[tc->y & CHUNK_MASK] | bit : c->has_dir[tc->y & CHUNK_MASK] & ~bit;
+    }
+}
+
+/// Drop the oldest keyframe and the changes that build on it
+void drop_oldest(rewind_buffer *rb) {
+    do {
+        snapshot *f = nth_snapshot(rb, 0);
+        rb->bytes -= f->bytes;
+        free_snapshot(f);
+        rb->head = (rb->head + 1) % rb->cap;
+        rb->len--;
+    } while (rb->len > 0 && nth_snapshot(rb, 0)->chunks == NULL);
+}
+
+/// Call after each tick (and after a reset, to start over from there)
+void rewind_tick(player_state *s, bool restart) {
+    rewind_buffer *rb = &rewind_state;
+    if (restart) {
+        while (rb->len > 0) drop_oldest(rb);
+        clear_changed();
+        track_changes = rb->max_bytes > 0;
+    }
+    if (!track_changes) return;
+    if (rb->len == rb->cap) drop_oldest(rb);
+
+    snapshot *f = nth_snapshot(rb, rb->len);
+    if (rb->len == 0 || ++rb->since_key >= REWIND_KEY_TICKS) {
+        take_keyframe(f, s);
+        rb->since_key = 0;
+    } else {
+        take_changes(f, s);
+    }
+    if (f->chunks == NULL && f->changes == NULL) {
+        // Out of memory: go without
+        free_snapshot(f);
+        track_changes = false;
+        return;
+    }
+    bool keyframe = f->chunks != NULL;
+    rb->len++;
+    rb->bytes += f->bytes;
+    while (rb->bytes > rb->max_bytes && rb->len > 0) drop_oldest(rb);
+    if (rb->len == 0 && keyframe) {
+        // Even a single keyframe of this world is over budget
+        clear_changed();
+        track_changes = false;
+    }
+    // Else if these changes took their keyframe with them, the next tick
+    // starts over with a keyframe (rb->len is 0)
+}
+
+/// Go back to the end of tick `t`, or as far back as there is. What came
+/// after it is forgotten.
+void rewind_to(player_state *s, uint32_t t) {
+    rewind_buffer *rb = &rewind_state;
+    if (rb->len == 0) return;
+    uint32_t first = nth_snapshot(rb, 0)->player.t;
+    uint32_t i = t < first ? 0 : min(t - first, rb->len - 1);
+    uint32_t k = i;
+    while (nth_snapshot(rb, k)->chunks == NULL) k--;
+
+    restore_chunks(nth_snapshot(rb, k));
+    for (uint32_t j = k + 1; j <= i; j++) {
+        restore_changes(nth_snapshot(rb, j));
+    }
+    wake_all();
+    snapshot *f = nth_snapshot(rb, i);
+    *s = f->player;
+    world_state.tick_gen = f->tick_gen;
+
+    while (rb->len > i + 1) {
+        snapshot *last = nth_snapshot(rb, rb->len - 1);
+        rb->bytes -= last->bytes;
+        free_snapshot(last);
+        rb->len--;
+    }
+    rb->since_key = i - k;
+    clear_changed();
+}
+
+// The level file as first loaded, for restarting without loading it again
+snapshot level_start = {0};
+int32_t level_w;
+int32_t level_h;
+uint64_t level_seed;
+
+void save_level_start(player_state *s) {
+    free_snapshot(&level_start);
+    take_keyframe(&level_start, s);
+    level_w = world_state.w;
+    level_h = world_state.h;
+    level_seed = world_state.seed;
+}
+
+bool restore_level_start(player_state *s) {
+    if (level_start.chunks == NULL || !init_world(level_w, level_h, level_seed)) {
+        return false;
+    }
+    restore_chunks(&level_start);
+    wake_all();
+    *s = level_start.player; // all of it, or a restart isn't the start
+    return true;
+}
+
+// ======================================
 
+// ============= Streaming ==================
+
+// A world can be a directory of levels, as LDtk's simplified export writes
+// them: a directory per level, each with its tiles.csv and a data.json
+// saying where in the world it sits. Only levels near the player are in the
+// world at all. The ones a little further out are read and decoded ahead
+// of time on a loader thread, so a level coming in is a copy, and far ones
+// are let go (and come back as their file has them). What's in the world
+// depends only on where the player is, never on how quick the disk was, so
+// replays and rewinds still match: a level needed before the loader has
+// got to it jumps its queue, and the tick waits for it.
+#define STREAM_NEAR 24     // tiles from the player: in the world
+#define STREAM_PREFETCH 64 // decoded, ready to go in
+#define STREAM_DROP 128    // the decoded copy goes too
+#define STREAM_NEIGHBOURS 8
+
+typedef enum {
+    LEVEL_IDLE,
+    LEVEL_QUEUED,  // for the loader thread
+    LEVEL_LOADING,
+    LEVEL_READY,   // `ids` has its tiles (NULL if it couldn't be read)
+} level_state;
+
+typedef struct {
+    char path[LDTK_PATH_LEN]; // of its tiles.csv
+    int32_t x;                // in the world, in tiles
+    int32_t y;
+    int32_t w;
+    int32_t h;
+    uint64_t iid;             // hashed, as neighbours name each other
+    uint64_t neighbour_iids[STREAM_NEIGHBOURS];
+    int32_t neighbours[STREAM_NEIGHBOURS]; // indices, or -1
+    uint8_t num_neighbours;
+    level_state state;        // shared with the loader, under `lock`
+    int32_t distance;         // when queued: nearest go first
+    uint8_t *ids;             // w * h CSV tile ids
+    bool resident;            // in the world
+} stream_level;
+
+typedef struct {
+    char dir[LDTK_PATH_LEN];
+    stream_level *levels;
+    uint32_t len;
+    uint64_t hash;            // of the data.json files, for the seed
+    bool on;                  // the world is this one (not a random level)
+    bool level_start;         // and so is level_start
+    int32_t prefetch_x;       // where the player was at the last prefetch
+    int32_t prefetch_y;
+    pthread_t loader;
+    bool started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t loaded;
+    bool quit;
+} streamer;
+
+streamer stream_state = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .loaded = PTHREAD_COND_INITIALIZER
+};
+
+/// Tiles from (x, y) to the nearest tile of the level, 0 inside it
+int32_t level_distance(stream_level *l, int32_t x, int32_t y) {
+    int32_t dx = max(0, max(l->x - x, x - (l->x + l->w - 1)));
+    int32_t dy = max(0, max(l->y - y, y - (l->y + l->h - 1)));
+    return max(dx, dy);
+}
+
+/// Read a level's CSV into w * h ids. Safe off the main thread: it touches
+/// nothing but the level's file and what it returns.
+uint8_t *decode_level(const stream_level *l) {
+    FILE *f = fopen(l->path, "r");
+    if (f == NULL) return NULL;
+    uint8_t *ids = calloc((size_t)l->w * l->h, 1);
+    char *line = NULL;
+    size_t cap = 0;
+    int32_t y = 0;
+    while (ids != NULL && y < l->h && getline(&line, &cap, f) > 0) {
+        int32_t x = 0;
+        const char *p = line;
+        char *end;
+        while (true) {
+            long id = strtol(p, &end, 10);
+            if (end == p) break;
+            if (x < l->w) ids[(size_t)y * l->w + x] = id > 0 && id <= 255 ? id : 0;
+            x++;
+            for (p = end; *p == ',' || *p == ' '; p++);
+        }
+        if (x > 0) y++;
+    }
+    free(line);
+    fclose(f);
+    return ids;
+}
+
+void *stream_loader(void *arg) {
+    streamer *st = arg;
+    pthread_mutex_lock(&st->lock);
+    while (!st->quit) {
+        stream_level *next = NULL;
+        for (uint32_t i = 0; i < st->len; i++) {
+            stream_level *l = &st->levels[i];
+            if (l->state == LEVEL_QUEUED && (next == NULL || l->distance < next->distance)) {
+                next = l;
+            }
+        }
+        if (next == NULL) {
+            pthread_cond_wait(&st->wake, &st->lock);
+            continue;
+        }
+        next->state = LEVEL_LOADING;
+        pthread_mutex_unlock(&st->lock);
+
+        uint8_t *ids = decode_level(next);
+
+        pthread_mutex_lock(&st->lock);
+        next->ids = ids;
+        next->state = LEVEL_READY;
+        pthread_cond_broadcast(&st->loaded);
+    }
+    pthread_mutex_unlock(&st->lock);
+    return NULL;
+}
+
+void stop_streaming() {
+    streamer *st = &stream_state;
+    if (!st->started) return;
+    pthread_mutex_lock(&st->lock);
+    st->quit = true;
+    pthread_cond_signal(&st->wake);
+    pthread_mutex_unlock(&st->lock);
+    pthread_join(st->loader, NULL);
+    st->started = false;
+}
+
+/// A level's tiles, now, as the loader thread publishes them: one it hasn't
+/// got to yet goes first in its queue. Only decoded here if there's no
+/// loader thread at all.
+const uint8_t *level_ids(stream_level *l) {
+    streamer *st = &stream_state;
+    pthread_mutex_lock(&st->lock);
+    if (l->state == LEVEL_IDLE || l->state == LEVEL_QUEUED) {
+        if (st->started) {
+            l->state = LEVEL_QUEUED;
+            l->distance = -1; // nearer than anything prefetched
+            pthread_cond_signal(&st->wake);
+        } else {
+            l->ids = decode_level(l);
+            l->state = LEVEL_READY;
+        }
+    }
+    while (l->state != LEVEL_READY) {
+        pthread_cond_wait(&st->loaded, &st->lock);
+    }
+    pthread_mutex_unlock(&st->lock);
+    return l->ids;
+}
+
+/// Queue what's close, or next door to where the player is, for the
+/// loader; forget decoded copies of what's far
+void prefetch_levels(int32_t x, int32_t y) {
+    streamer *st = &stream_state;
+    st->prefetch_x = x;
+    st->prefetch_y = y;
+    pthread_mutex_lock(&st->lock);
+    for (uint32_t i = 0; i < st->len; i++) {
+        stream_level *l = &st->levels[i];
+        l->distance = level_distance(l, x, y);
+    }
+    for (uint32_t i = 0; i < st->len; i++) {
+        stream_level *l = &st->levels[i];
+        if (l->distance != 0) continue;
+        for (uint8_t n = 0; n < l->num_neighbours; n++) {
+            if (l->neighbours[n] >= 0) {
+                stream_level *nb = &st->levels[l->neighbours[n]];
+                nb->distance = min(nb->distance, STREAM_PREFETCH);
+            }
+        }
+    }
+    bool queued = false;
+    for (uint32_t i = 0; i < st->len; i++) {
+        stream_level *l = &st->levels[i];
+        if (l->distance <= STREAM_PREFETCH && l->state == LEVEL_IDLE) {
+            l->state = LEVEL_QUEUED;
+            queued = true;
+        } else if (l->distance > STREAM_PREFETCH && l->state == LEVEL_QUEUED) {
+            l->state = LEVEL_IDLE;
+        } else if (l->distance > STREAM_DROP && l->state == LEVEL_READY && !l->resident) {
+            free(l->ids);
+            l->ids = NULL;
+            l->state = LEVEL_IDLE;
+        }
+    }
+    if (queued) pthread_cond_signal(&st->wake);
+    pthread_mutex_unlock(&st->lock);
+}
+
+/// Write a level's tiles into the world over whatever's there. Only the
+/// level the player starts in gets to place the player (`s`).
+void install_level(stream_level *l, player_state *s) {
+    const uint8_t *ids = level_ids(l);
+    for (int32_t y = 0; ids != NULL && y < l->h; y++) {
+        for (int32_t x = 0; x < l->w; x++) {
+            int32_t wx = l->x + x;
+            int32_t wy = l->y + y;
+            uint8_t v = ids[(size_t)y * l->w + x];
+            if (!in_world(wx, wy)) continue;
+            if (!is_plain_saved_tile(v) && (s != NULL || savefile_idx[v] != TILE_PLAYER)) {
+                place_saved_tile(wx, wy, v, s);
+                continue;
+            }
+            tile_type t = is_plain_saved_tile(v) && v < sizeof(savefile_idx) / sizeof(savefile_idx[0]) ?
+                savefile_idx[v] : TILE_EMPTY;
+            chunk *c = t == TILE_EMPTY ? get_chunk(wx, wy) : alloc_chunk(wx, wy);
+            if (c == NULL) continue;
+            c->types[wy & CHUNK_MASK][wx & CHUNK_MASK] = t;
+            c->data[wy & CHUNK_MASK][wx & CHUNK_MASK] = (tile_data){0};
+            c->has_dir[wy & CHUNK_MASK] &= ~(1U << (wx & CHUNK_MASK));
+        }
+    }
+    for (int32_t y = l->y - 1; y <= l->y + l->h; y++) {
+        for (int32_t x = l->x - 1; x <= l->x + l->w; x++) {
+            wake_tile(x, y);
+        }
+    }
+}
+
+/// Empty a level's part of the world, and free the chunks that leaves empty
+void evict_level(stream_level *l) {
+    world *wd = &world_state;
+    int32_t x1 = min(l->x + l->w, wd->w);
+    int32_t y1 = min(l->y + l->h, wd->h);
+    for (int32_t cy = l->y >> CHUNK_BITS; cy <= (y1 - 1) >> CHUNK_BITS; cy++) {
+        for (int32_t cx = l->x >> CHUNK_BITS; cx <= (x1 - 1) >> CHUNK_BITS; cx++) {
+            uint32_t index = cy * wd->cols + cx;
+            chunk *c = wd->chunks[index];
+            if (c == NULL) continue;
+            int32_t tx0 = max(l->x, cx << CHUNK_BITS);
+            int32_t ty0 = max(l->y, cy << CHUNK_BITS);
+            int32_t tx1 = min(x1, (cx + 1) << CHUNK_BITS);
+            int32_t ty1 = min(y1, (cy + 1) << CHUNK_BITS);
+            for (int32_t y = ty0; y < ty1; y++) {
+                for (int32_t x = tx0; x < tx1; x++) {
+                    sleep_tile(x, y);
+                    c->types[y & CHUNK_MASK][x & CHUNK_MASK] = TILE_EMPTY;
+                    c->data[y & CHUNK_MASK][x & CHUNK_MASK] = (tile_data){0};
+                    c->has_dir[y & CHUNK_MASK] &= ~(1U << (x & CHUNK_MASK));
+                    c->ticked[y & CHUNK_MASK] &= ~(1U << (x & CHUNK_MASK));
+                }
+            }
+            // Chunks straddle levels: only go once nothing's left in them
+            bool empty = !c->listed;
+            for (int32_t r = 0; empty && r < CHUNK_SIZE; r++) {
+                for (int32_t x = 0; empty && x < CHUNK_SIZE; x++) {
+                    empty = c->types[r][x] == TILE_EMPTY;
+                }
+            }
+            if (!empty) continue;
+            // Empty tiles outside the level may still be awake
+            for (int32_t r = 0; r < CHUNK_SIZE; r++) {
+                int32_t y = (cy << CHUNK_BITS) + r;
+                if (y < wd->h) wd->row_awake[y] -= __builtin_popcount(c->awake[r]);
+            }
+            free(c);
+            wd->chunks[index] = NULL;
+            wd->num_chunks--;
+        }
+    }
+}
+
+/// After the world's been put back (a rewind or a restart): it has the
+/// levels near where the player was, so that's what's resident
+void stream_sync(player_state *s) {
+    streamer *st = &stream_state;
+    if (!st->on) return;
+    for (uint32_t i = 0; i < st->len; i++) {
+        stream_level *l = &st->levels[i];
+        l->resident = level_distance(l, s->x, s->y) <= STREAM_NEAR;
+    }
+    prefetch_levels(s->x, s->y);
+}
+
+/// Call after each tick: bring in the levels the player is now near and
+/// let go of the ones left behind
+void stream_tick(player_state *s) {
+    streamer *st = &stream_state;
+    if (!st->on) return;
+    bool reshaped = false;
+    for (uint32_t i = 0; i < st->len; i++) {
+        stream_level *l = &st->levels[i];
+        bool near = level_distance(l, s->x, s->y) <= STREAM_NEAR;
+        if (near == l->resident) continue;
+        if (!reshaped) {
+            // Whole levels are too much for the rewind buffer's per-tile
+            // changes: the next snapshot is a keyframe instead
+            clear_changed();
+            rewind_state.since_key = REWIND_KEY_TICKS;
+            reshaped = true;
+        }
+        if (near) {
+            install_level(l, NULL);
+        } else {
+            evict_level(l);
+        }
+        l->resident = near;
+    }
+    if (s->x != st->prefetch_x || s->y != st->prefetch_y) {
+        prefetch_levels(s->x, s->y);
+    }
+}
+
+typedef struct {
+    stream_level *level;
+    int32_t px[4]; // x, y, width, height, in pixels
+} level_index;
+
+void level_index_value(json_parser *p, json_kind kind, const char *str, double num) {
+    level_index *ix = p->ctx;
+    stream_level *l = ix->level;
+    const char *k = json_key(p, 0);
+    if (p->depth == 1) {
+        if (strcmp(k, "uniqueIdentifer") == 0 || strcmp(k, "iid") == 0) {
+            l->iid = hash_bytes(0xCBF29CE484222325ULL, str, strlen(str));
+        }
+        else if (strcmp(k, "x") == 0) ix->px[0] = num;
+        else if (strcmp(k, "y") == 0) ix->px[1] = num;
+        else if (strcmp(k, "width") == 0) ix->px[2] = num;
+        else if (strcmp(k, "height") == 0) ix->px[3] = num;
+    } else if (p->depth == 3 && strcmp(k, "neighbourLevels") == 0 &&
+               strcmp(json_key(p, 2), "levelIid") == 0 && kind == JSON_STRING &&
+               l->num_neighbours < STREAM_NEIGHBOURS) {
+        l->neighbour_iids[l->num_neighbours++] = hash_bytes(0xCBF29CE484222325ULL, str, strlen(str));
+    }
+}
+
+/// Where a level goes, from its data.json, and how big it is, from the
+/// first row of its CSV (which gives the pixels per tile). Also hashes the
+/// data.json into `h`.
+bool index_level(const char *json_path, stream_level *l, uint64_t *h) {
+    FILE *f = fopen(json_path, "rb");
+    if (f == NULL) return false;
+    level_index ix = { .level = l };
+    json_parser p;
+    json_init(&p, &ix);
+    p.value = level_index_value;
+    char buf[4096];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        ok = json_feed(&p, buf, n);
+        *h = hash_bytes(*h, buf, n);
+    }
+    fclose(f);
+    if (!ok || !json_finish(&p)) return false;
+
+    snprintf(l->path, sizeof(l->path), "%.*s/tiles.csv",
+             (int)(strrchr(json_path, '/') - json_path), json_path);
+    f = fopen(l->path, "r");
+    if (f == NULL) return false;
+    char *line = NULL;
+    size_t cap = 0;
+    int32_t cols = 0;
+    while (cols == 0 && getline(&line, &cap, f) > 0) {
+        cols = load_level_row(line, -1, NULL);
+    }
+    free(line);
+    fclose(f);
+    if (cols == 0 || ix.px[2] < cols) return false;
+    int32_t grid = ix.px[2] / cols;
+    l->x = ix.px[0] / grid;
+    l->y = ix.px[1] / grid;
+    l->w = cols;
+    l->h = ix.px[3] / grid;
+    return l->h > 0;
+}
+
+/// Read the index of the levels under `dir`, if it has any
+bool index_world(const char *dir) {
+    streamer *st = &stream_state;
+    char pattern[LDTK_PATH_LEN + 16];
+    snprintf(pattern, sizeof(pattern), "%s/*/data.json", dir);
+    glob_t found;
+    if (glob(pattern, 0, NULL, &found) != 0) return false;
+    stream_level *levels = calloc(found.gl_pathc, sizeof(stream_level));
+    uint32_t len = 0;
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; levels != NULL && i < found.gl_pathc; i++) {
+        if (index_level(found.gl_pathv[i], &levels[len], &h)) len++;
+    }
+    globfree(&found);
+    if (len == 0) {
+        free(levels);
+        return false;
+    }
+
+    // In the world's own tiles: the top-left level at 0,0
+    int32_t x0 = INT32_MAX;
+    int32_t y0 = INT32_MAX;
+    for (uint32_t i = 0; i < len; i++) {
+        x0 = min(x0, levels[i].x);
+        y0 = min(y0, levels[i].y);
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        stream_level *l = &levels[i];
+        l->x -= x0;
+        l->y -= y0;
+        for (uint8_t n = 0; n < l->num_neighbours; n++) {
+            l->neighbours[n] = -1;
+            for (uint32_t j = 0; j < len; j++) {
+                if (levels[j].iid == l->neighbour_iids[n]) l->neighbours[n] = j;
+            }
+        }
+    }
+
+    stop_streaming();
+    for (uint32_t i = 0; i < st->len; i++) free(st->levels[i].ids);
+    free(st->levels);
+    st->levels = levels;
+    st->len = len;
+    st->hash = h;
+    st->quit = false;
+    snprintf(st->dir, sizeof(st->dir), "%s", dir);
+    st->started = pthread_create(&st->loader, NULL, stream_loader, st) == 0;
+    return true;
+}
+
+/// Start a streamed world: the player begins in the level under `s`, or the
+/// first one, and only what's near that is read before the first tick
+bool load_world(const char *dir, player_state *s) {
+    streamer *st = &stream_state;
+    if (strcmp(st->dir, dir) != 0 && !index_world(dir)) {
+        printf("No levels in %s\n", dir);
+        return false;
+    }
+    int32_t w = 0;
+    int32_t h = 0;
+    for (uint32_t i = 0; i < st->len; i++) {
+        st->levels[i].resident = false;
+        w = max(w, st->levels[i].x + st->levels[i].w);
+        h = max(h, st->levels[i].y + st->levels[i].h);
+    }
+    if (!init_world(w, h, st->hash ^ seed)) {
+        printf("Bad world size %dx%d in %s\n", w, h, dir);
+        return false;
+    }
+
+    // No reading every level for a player tile: the start level is the one
+    // under the player, and its own player tile, if any, says where exactly
+    stream_level *start = &st->levels[0];
+    for (uint32_t i = 0; i < st->len; i++) {
+        if (level_distance(&st->levels[i], s->x, s->y) == 0) {
+            start = &st->levels[i];
+            break;
+        }
+    }
+    s->x = max(start->x, min(s->x, start->x + start->w - 1));
+    s->y = max(start->y, min(s->y, start->y + start->h - 1));
+    install_level(start, s);
+    start->resident = true;
+    st->on = true;
+    prefetch_levels(s->x, s->y);
+    stream_tick(s); // the rest of what's near
+    return true;
+}
+
+/// The file to load for `name`: a directory can be one exported level
+const char *level_path(const char *name, char *buf, size_t size) {
+    struct stat st;
+    if (stat(name, &st) != 0 || !S_ISDIR(st.st_mode)) return name;
+    snprintf(buf, size, "%s/tiles.csv", name);
+    return access(buf, R_OK) == 0 ? buf : name;
+}
+
+/// A directory of levels, to stream
+bool is_world(const char *name) {
+    char buf[LDTK_PATH_LEN + 16];
+    struct stat st;
+    return level_path(name, buf, sizeof(buf)) == name &&
+        stat(name, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/// A level file, the directory of an exported level, or a world
+bool load_start(const char *name, player_state *s) {
+    stream_state.on = false;
+    if (level_mem == NULL && is_world(name)) return load_world(name, s);
+    char buf[LDTK_PATH_LEN + 16];
+    return load_level(level_path(name, buf, sizeof(buf)), s);
+}
+
+// ======================================
+
+// Background stars: generated once per screen size, then re-sent as is
+ansi_out *starfield = NULL;
+uint16_t starfield_w = 0;
+uint16_t starfield_h = 0;
+
+void build_starfield(ansi_out *o, uint16_t w, uint16_t h) {
+    o->len = 0;
+    out_sgr_reset(o);
+    out_bg(o, C_BLACK);
+    rng r = make_rng(seed, RNG_STARS);
+    for (int j = 1; j <= h; j++) {
+        out_cursor_to(o, 1, j);
+        for (int i = 1; i <= w; i++) {
+            if (rng_below(&r, 30) == 0) {
+                // Star
+                out_fg(o, rng_below(&r, 20) + 232);
+                out_char(o, '.');
+            } else {
+                // Empty
+                out_char(o, ' ');
+            }
+        }
+    }
+}
+
+void bg_fill() {
+    if (starfield == NULL) {
+        starfield = make_ansi_out(OUT_BUF_SIZE);
+    }
+    if (starfield_w != scr_w || starfield_h != scr_h) {
+        build_starfield(starfield, scr_w, scr_h);
+        starfield_w = scr_w;
+        starfield_h = scr_h;
+    }
+    out_bytes(out, starfield->buf, starfield->len);
+    out->fg = starfield->fg;
+    out->bg = starfield->bg;
+}
+
+void done(int signum) {
+    esc("?25h"); // show cursor
+    esc("0m"); // reset fg/bg
+    out_sgr_reset(out);
     cursor_to(0, 0);
+    out_flush(out, STDOUT_FILENO);
+
+    init_ansi_keys(false);
+    fflush(stdout);
     exit(signum);
 };
 
@@ -1083,46 +2938,780 @@ void resize() {
     scr_w = win.ws_col;
     scr_h = win.ws_row;
     bg_fill();
+    full_repaint = true;
 }
 
+// ============= Signals ==================
+
+// Handlers only write the signal number into a pipe (async-signal-safe);
+// the main loop reads it back. Any number of SIGWINCHs between two reads
+// turn into one repaint.
+int sig_pipe[2] = {-1, -1};
+
+void on_signal(int signum) {
+    int saved = errno;
+    char c = signum;
+    write(sig_pipe[1], &c, 1);
+    errno = saved;
+}
+
+void init_signals() {
+    pipe(sig_pipe);
+    for (int i = 0; i < 2; i++) {
+        fcntl(sig_pipe[i], F_SETFL, fcntl(sig_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(sig_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal, .sa_flags = SA_RESTART };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGWINCH, &sa, NULL);
+}
+
+typedef struct {
+    bool quit;
+    bool resized;
+} pending_signals;
+
+pending_signals read_signals() {
+    pending_signals p = {0};
+    char buf[64];
+    ssize_t n;
+    while ((n = read(sig_pipe[0], buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == SIGINT) p.quit = true;
+            if (buf[i] == SIGWINCH) p.resized = true;
+        }
+    }
+    return p;
+}
+
+// ============= Output thread ==================
+
+// The game renders into `pixels` and hands a copy over; the output thread
+// owns `out` and the terminal, and encodes + writes the latest frame.
+// Three slots, so the game always has one free to publish into: if the
+// previous frame wasn't picked up yet it is replaced (dropped), never queued.
+
+#define STATUS_LEN 160
+
+typedef struct {
+    uint8_t pixels[PIX_H][PIX_W];
+    int32_t cam_x;
+    int32_t cam_y;
+    uint32_t size_gen; // bumped by the game on every (coalesced) SIGWINCH
+    char status[STATUS_LEN];
+} frame;
+
+// Skip frames while more than this is still waiting to go out to the tty
+#define DEFAULT_OUTQ_LIMIT 8192
+
+typedef struct {
+    size_t bytes;     // size of the last written frame
+    long encode_us;   // time to encode it
+    int queued;       // bytes still in the tty output queue
+    uint32_t dropped; // frames replaced before the output thread got to them
+    uint32_t skipped; // frames not sent because the tty was backed up
+} output_stats;
+
+typedef struct {
+    frame slots[3];
+    int8_t back;   // game is filling this one
+    int8_t ready;  // latest published frame, -1 if none
+    int8_t busy;   // output thread is encoding this one, -1 if none
+    bool running;
+    uint32_t size_gen; // last screen size the output thread has drawn for
+    int outq_limit;
+    output_stats stats;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} output;
+
+output output_state = {
+    .back = 0,
+    .ready = -1,
+    .busy = -1,
+    .outq_limit = DEFAULT_OUTQ_LIMIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+void encode_frame(output *o, frame *f) {
+    if (f->size_gen != o->size_gen) {
+        o->size_gen = f->size_gen;
+        resize();
+    }
+    render_pixels((frame_pixels)f->pixels, f->cam_x, f->cam_y);
+
+    set_bg(C_BLACK);
+    set_fg(C_WHITE);
+    // One screen row per line of status, below the view
+    uint16_t row = view_top() + PIX_H / cell_h;
+    for (const char *line = f->status; line != NULL; row++) {
+        const char *end = strchr(line, '\n');
+        cursor_to(view_left(), row);
+        out_bytes(out, line, end ? (size_t)(end - line) : strlen(line));
+        line = end ? end + 1 : NULL;
+    }
+}
+
+/// Bytes written to `fd` that the tty hasn't sent on yet (0 if unknown)
+int output_queued(int fd) {
+    int queued = 0;
+    if (ioctl(fd, TIOCOUTQ, &queued) < 0) return 0;
+    return queued;
+}
+
+void *output_thread(void *arg) {
+    output *o = (output *)arg;
+    pthread_mutex_lock(&o->lock);
+    while (true) {
+        while (o->running && o->ready == -1) {
+            pthread_cond_wait(&o->cond, &o->lock);
+        }
+        if (!o->running) break;
+        o->busy = o->ready;
+        o->ready = -1;
+        pthread_mutex_unlock(&o->lock);
+
+        // Backed up (slow ssh...): adding more would only add latency. Skip
+        // this frame and wait a bit for the queue to drain; the next frame
+        // diffs against what was actually sent, so nothing is lost.
+        int queued = output_queued(STDOUT_FILENO);
+        if (queued > o->outq_limit) {
+            struct pollfd pfd = { .fd = STDOUT_FILENO, .events = POLLOUT };
+            poll(&pfd, 1, 10);
+            pthread_mutex_lock(&o->lock);
+            o->busy = -1;
+            o->stats.queued = queued;
+            o->stats.skipped++;
+            continue;
+        }
+
+        struct timespec enc_start, enc_end;
+        clock_gettime(CLOCK_MONOTONIC, &enc_start);
+        encode_frame(o, &o->slots[o->busy]);
+        clock_gettime(CLOCK_MONOTONIC, &enc_end);
+        long encode_us = (enc_end.tv_sec - enc_start.tv_sec) * 1000000 +
+            (enc_end.tv_nsec - enc_start.tv_nsec) / 1000;
+        size_t bytes = out_flush(out, STDOUT_FILENO); // may block: only this thread waits
+
+        pthread_mutex_lock(&o->lock);
+        o->busy = -1;
+        o->stats.bytes = bytes;
+        o->stats.encode_us = encode_us;
+        o->stats.queued = queued;
+    }
+    pthread_mutex_unlock(&o->lock);
+    return NULL;
+}
+
+void start_output() {
+    output_state.running = true;
+    pthread_create(&output_state.thread, NULL, output_thread, &output_state);
+}
+
+void stop_output() {
+    pthread_mutex_lock(&output_state.lock);
+    output_state.running = false;
+    pthread_cond_signal(&output_state.cond);
+    pthread_mutex_unlock(&output_state.lock);
+    pthread_join(output_state.thread, NULL);
+}
+
+/// Hand the current `pixels` to the output thread. Never waits on the tty.
+/// Returns the latest output stats.
+output_stats publish_frame(player_state *s, uint32_t size_gen, const char *status) {
+    output *o = &output_state;
+    frame *f = &o->slots[o->back];
+    memcpy(f->pixels, pixels, sizeof(pixels));
+    f->cam_x = s->cam_x;
+    f->cam_y = s->cam_y;
+    f->size_gen = size_gen;
+    snprintf(f->status, STATUS_LEN, "%s", status);
+
+    pthread_mutex_lock(&o->lock);
+    int8_t stale = o->ready;
+    o->ready = o->back;
+    if (stale != -1) {
+        o->stats.dropped++;
+        o->back = stale;
+    } else {
+        // whichever slot is neither ready nor being encoded
+        for (int8_t i = 0; i < 3; i++) {
+            if (i != o->ready && i != o->busy) o->back = i;
+        }
+    }
+    output_stats stats = o->stats;
+    pthread_cond_signal(&o->cond);
+    pthread_mutex_unlock(&o->lock);
+    return stats;
+}
+
+const char *level_file = "data/level/simplified/level_1/tiles.csv";
+int32_t random_w = DEFAULT_WORLD_W;
+int32_t random_h = DEFAULT_WORLD_H;
+
+// ============= Recording ==================
+
+// A recording: seed, tick mode and level up front, then each tick's input
+// (run-length coded), resets, and a world hash every REPLAY_HASH_TICKS.
+#define REPLAY_MAGIC "TRRY"
+#define REPLAY_VERSION 5
+#define REPLAY_HASH_TICKS 60
+
+// Input bytes are dx:2 dy:2 dig:1 slot:1; anything with the top bit set is
+// an event instead.
+enum {
+    REC_RESTART = 0x80,
+    REC_RANDOM,
+    REC_HASH,   // followed by the hash, 8 bytes
+    REC_REWIND, // followed by the tick rewound to, 4 bytes
+};
+
+typedef struct {
+    FILE *file;
+    uint8_t input; // of the ticks in `run`
+    uint32_t run;  // ticks not written out yet
+    uint32_t ticks;
+} recorder;
+
+recorder recording = {0};
+
+uint8_t input_byte(player_state *s) {
+    return (s->dx & 3) | (s->dy & 3) << 2 | s->dig << 4 | (s->slot & 1) << 5;
+}
+
+void apply_input(player_state *s, uint8_t b) {
+    s->dx = (int8_t)(b << 6) >> 6;
+    s->dy = (int8_t)(b << 4) >> 6;
+    s->dig = (b >> 4) & 1;
+    s->slot = (b >> 5) & 1;
+}
+
+void put_u32(FILE *f, uint32_t v) {
+    for (int i = 0; i < 4; i++) fputc(v >> (i * 8), f);
+}
+
+void put_u64(FILE *f, uint64_t v) {
+    for (int i = 0; i < 8; i++) fputc(v >> (i * 8), f);
+}
+
+bool get_u32(FILE *f, uint32_t *v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, f) != 4) return false;
+    *v = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+    return true;
+}
+
+bool get_u64(FILE *f, uint64_t *v) {
+    uint32_t lo, hi;
+    if (!get_u32(f, &lo) || !get_u32(f, &hi)) return false;
+    *v = (uint64_t)hi << 32 | lo;
+    return true;
+}
+
+/// Everything a tick can change, boiled down. Empty chunks count the same
+/// whether or not they've been allocated.
+uint64_t world_hash(player_state *s) {
+    world *wd = &world_state;
+    uint64_t h = wd->tick_gen;
+    for (size_t i = 0; i < (size_t)wd->cols * wd->rows; i++) {
+        chunk *c = wd->chunks[i];
+        if (c == NULL) continue;
+        uint64_t ch = i + 1;
+        bool any = false;
+        for (int32_t y = 0; y < CHUNK_SIZE; y++) {
+            for (int32_t x = 0; x < CHUNK_SIZE; x++) {
+                if (c->types[y][x] == TILE_EMPTY) continue;
+                any = true;
+                uint32_t d;
+                memcpy(&d, &c->data[y][x], sizeof(d));
+                ch = (ch ^ ((uint64_t)d << 16 | c->types[y][x] << 10 | y << 5 | x)) * 0x100000001B3ULL;
+            }
+        }
+        if (any) h = rng_hash(h, ch, ch >> 32, i);
+    }
+    h ^= (uint64_t)rng_hash(h, s->x, s->y, s->lives) << 32;
+    return h ^ rng_hash(h, s->t, s->dir.x & 0xff, s->dir.y & 0xff);
+}
+
+/// Pass a run length as 7 bits a byte, low bits first
+void put_run(FILE *f, uint32_t n) {
+    while (n >= 0x80) {
+        fputc(0x80 | (n & 0x7f), f);
+        n >>= 7;
+    }
+    fputc(n, f);
+}
+
+void flush_run(recorder *r) {
+    if (r->run == 0) return;
+    fputc(r->input, r->file);
+    put_run(r->file, r->run);
+    r->run = 0;
+}
+
+char *read_file(const char *name, size_t *len) {
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) return NULL;
+    char *buf = NULL;
+    size_t cap = 0;
+    *len = 0;
+    for (;;) {
+        if (*len == cap) {
+            cap = cap ? cap * 2 : 4096;
+            char *b = realloc(buf, cap);
+            if (b == NULL) break;
+            buf = b;
+        }
+        size_t n = fread(buf + *len, 1, cap - *len, f);
+        if (n == 0) break;
+        *len += n;
+    }
+    fclose(f);
+    return buf;
+}
+
+/// Start writing a recording. From here on the level comes from the copy
+/// that went into it, so a restart plays what a replay will. A world is
+/// too big for that: its directory is recorded instead.
+bool start_recording(const char *name) {
+    FILE *f = fopen(name, "wb");
+    if (f == NULL) return false;
+    bool world = is_world(level_file);
+    if (!world) {
+        char buf[LDTK_PATH_LEN + 16];
+        level_mem = read_file(level_path(level_file, buf, sizeof(buf)), &level_len);
+        if (level_mem == NULL) level_len = 0;
+    }
+
+    fwrite(REPLAY_MAGIC, 1, 4, f);
+    put_u32(f, REPLAY_VERSION);
+    put_u64(f, seed);
+    put_u32(f, random_w);
+    put_u32(f, random_h);
+    // Rewinding as far back as the recording did needs the same buffer
+    put_u64(f, rewind_state.max_bytes);
+    put_u32(f, rewind_state.cap);
+    put_u32(f, level_len);
+    fwrite(level_mem, 1, level_len, f);
+    put_u32(f, world ? strlen(level_file) : 0);
+    fwrite(level_file, 1, world ? strlen(level_file) : 0, f);
+    recording = (recorder){ .file = f };
+    return true;
+}
+
+void record_reset(bool rando) {
+    recorder *r = &recording;
+    if (r->file == NULL) return;
+    flush_run(r);
+    fputc(rando ? REC_RANDOM : REC_RESTART, r->file);
+}
+
+void record_rewind(uint32_t t) {
+    recorder *r = &recording;
+    if (r->file == NULL) return;
+    flush_run(r);
+    fputc(REC_REWIND, r->file);
+    put_u32(r->file, t);
+}
+
+/// Call after each tick, with the input_byte taken before it: the tick
+/// itself changes some of the input (a push with dig clears dig)
+void record_tick(player_state *s, uint8_t b) {
+    recorder *r = &recording;
+    if (r->file == NULL) return;
+    if (r->run > 0 && b != r->input) flush_run(r);
+    r->input = b;
+    r->run++;
+    if (++r->ticks % REPLAY_HASH_TICKS == 0) {
+        flush_run(r);
+        fputc(REC_HASH, r->file);
+        put_u64(r->file, world_hash(s));
+        fflush(r->file); // a crash should leave something to replay
+    }
+}
+
+void stop_recording() {
+    recorder *r = &recording;
+    if (r->file == NULL) return;
+    flush_run(r);
+    fclose(r->file);
+    r->file = NULL;
+}
+
+// ======================================
+
 void reset(player_state *s, bool rando) {
+    record_reset(rando);
     s->x = 2;
     s->y = 2;
     s->lives = 16;
     if (rando) {
+        if (!init_world(random_w, random_h, rng_next64(&levels_rng))) {
+            fprintf(stderr, "Can't make a %dx%d world\n", random_w, random_h);
+            exit(1);
+        }
         random_level(s->x, s->y);
-    } else {
-        load_level("data/level/simplified/level_1/tiles.csv", s);
+        stream_state.on = false;
+    } else if (restore_level_start(s)) {
+        stream_state.on = stream_state.level_start;
+        stream_sync(s);
+    } else if (load_start(level_file, s)) {
+        save_level_start(s);
+        stream_state.level_start = stream_state.on;
     }
-    s->cam_x = s->x * px_per_tile;
-    s->cam_y = s->y * px_per_tile;
+    snap_camera(s);
+    rewind_tick(s, true);
 
     init_particles();
 }
 
-int main() {
-    srand(time(0));
+// ============= Timing ==================
+
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/// Arm `timer` (a timerfd) for an absolute CLOCK_MONOTONIC time; 0 disarms
+void set_timer_ns(int timer, uint64_t t) {
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = t / NS_PER_SEC;
+    its.it_value.tv_nsec = t % NS_PER_SEC;
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &its, NULL);
+}
 
-    signal(SIGINT, done);
-    signal(SIGWINCH, resize);
+// Fixed timestep: time is banked and spent in `step_ns` chunks
+typedef struct {
+    uint64_t step_ns;
+    uint64_t acc;
+    uint64_t last;
+} accumulator;
+
+accumulator make_accumulator(double hz, uint64_t now) {
+    accumulator a = { .step_ns = NS_PER_SEC / hz, .acc = 0, .last = now };
+    return a;
+}
+
+/// How many steps are due at `now` (at most `max_steps`; any backlog
+/// beyond that is thrown away).
+uint32_t accumulate(accumulator *a, uint64_t now, uint32_t max_steps) {
+    a->acc += now - a->last;
+    a->last = now;
+    uint32_t steps = a->acc / a->step_ns;
+    if (steps > max_steps) {
+        steps = max_steps;
+        a->acc = 0;
+    } else {
+        a->acc -= steps * a->step_ns;
+    }
+    return steps;
+}
+
+/// When the next step will be due
+uint64_t next_step_ns(accumulator *a) {
+    return a->last + (a->step_ns - a->acc);
+}
+
+// ============= Replay ==================
+
+/// Play a recording back as fast as it'll go, with no terminal at all.
+/// Returns the exit status: non-zero if it can't be read or diverges.
+int replay(const char *name, int threads) {
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s\n", name);
+        return 1;
+    }
+    char magic[4];
+    uint32_t version, w, h, rewind_ticks, embedded_len;
+    uint64_t rewind_bytes;
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+        !get_u32(f, &version) || version != REPLAY_VERSION ||
+        !get_u64(f, &seed) || !get_u32(f, &w) || !get_u32(f, &h) ||
+        !get_u64(f, &rewind_bytes) ||
+        !get_u32(f, &rewind_ticks) || !get_u32(f, &embedded_len)) {
+        fprintf(stderr, "%s isn't a recording\n", name);
+        fclose(f);
+        return 1;
+    }
+    random_w = w;
+    random_h = h;
+    struct stat st;
+    if (fstat(fileno(f), &st) < 0 || embedded_len > st.st_size - ftell(f)) {
+        fprintf(stderr, "%s is cut short\n", name);
+        fclose(f);
+        return 1;
+    }
+    level_len = embedded_len;
+    level_mem = malloc(max(1, level_len));
+    if (level_mem == NULL) {
+        fprintf(stderr, "Out of memory for the level in %s\n", name);
+        fclose(f);
+        return 1;
+    }
+    static char world_dir[LDTK_PATH_LEN];
+    uint32_t world_len;
+    if (fread(level_mem, 1, level_len, f) != level_len || !get_u32(f, &world_len) ||
+        world_len >= sizeof(world_dir) || fread(world_dir, 1, world_len, f) != world_len) {
+        fprintf(stderr, "%s is cut short\n", name);
+        fclose(f);
+        return 1;
+    }
+    if (world_len > 0) {
+        world_dir[world_len] = '\0';
+        level_file = world_dir;
+        free(level_mem);
+        level_mem = NULL;
+    }
+    levels_rng = make_rng(seed, RNG_LEVELS);
+    fx_rng = make_rng(seed, RNG_FX);
+    init_rewind(rewind_bytes, rewind_ticks);
+    if (threads > 0) {
+        start_tick_pool(threads);
+    }
+
+    player_state s = {0};
+    uint64_t ticks = 0;
+    uint32_t checks = 0;
+    int status = 0;
+    uint64_t start = now_ns();
+    int b;
+    while (status == 0 && (b = fgetc(f)) != EOF) {
+        if (b == REC_RESTART || b == REC_RANDOM) {
+            reset(&s, b == REC_RANDOM);
+        } else if (b == REC_REWIND) {
+            uint32_t t;
+            if (!get_u32(f, &t)) break;
+            rewind_to(&s, t);
+            stream_sync(&s);
+        } else if (b == REC_HASH) {
+            uint64_t want;
+            if (!get_u64(f, &want)) break;
+            uint64_t got = world_hash(&s);
+            checks++;
+            if (got != want) {
+                fprintf(stderr, "Diverged by tick %" PRIu64 ": hash %016" PRIx64
+                        ", recorded %016" PRIx64 "\n", ticks, got, want);
+                status = 2;
+            }
+        } else if (b & 0x80) {
+            fprintf(stderr, "Bad record %02x after tick %" PRIu64 "\n", b, ticks);
+            status = 1;
+        } else {
+            uint32_t run = 0;
+            int c;
+            for (int shift = 0; shift < 32 && (c = fgetc(f)) != EOF; shift += 7) {
+                run |= (uint32_t)(c & 0x7f) << shift;
+                if (!(c & 0x80)) break;
+            }
+            for (; run > 0; run--) {
+                apply_input(&s, b); // as play sets it before every tick
+                s.t++;
+                tick_tiles(&s);
+                stream_tick(&s);
+                rewind_tick(&s, false);
+                ticks++;
+            }
+        }
+    }
+    double secs = (now_ns() - start) / (double)NS_PER_SEC;
+    printf("%" PRIu64 " ticks in %.3fs (%.0f ticks/s), %u hash checks, final hash %016" PRIx64 "\n",
+           ticks, secs, ticks / max(secs, 1e-9), checks, world_hash(&s));
+    fclose(f);
+    stop_tick_pool();
+    stop_streaming();
+    return status;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s] [-f fps] [-t ticks] [-q bytes] [-l level.csv] [-r WxH] [-j threads] [-S seed] [-m MB] [-R file] [-v]\n"
+                    "       %s -P recording [-j threads]\n", name, name);
+    fprintf(stderr, "  -s        draw with sextants (2x3 pixels per character)\n");
+    fprintf(stderr, "  -f fps    frames drawn per second (default %d)\n", DEFAULT_FPS);
+    fprintf(stderr, "  -t ticks  world updates per second (default %.1f)\n", DEFAULT_TICK_HZ);
+    fprintf(stderr, "  -q bytes  skip frames while the tty has more than this queued (default %d)\n",
+            DEFAULT_OUTQ_LIMIT);
+    fprintf(stderr, "  -l file   level to play (default %s), or a directory\n"
+                    "            of exported levels to stream as one world\n", level_file);
+    fprintf(stderr, "  -r WxH    start on a random level of this size (default %dx%d)\n",
+            DEFAULT_WORLD_W, DEFAULT_WORLD_H);
+    fprintf(stderr, "  -j n      tick on n threads, in strips of the world (same results\n"
+                    "            as one thread; worlds with lasers stay on one)\n");
+    fprintf(stderr, "  -S seed   same seed, same levels and same game (default: the time)\n");
+    fprintf(stderr, "  -m MB     memory for rewinding up to %ds (default %d, 0: none)\n",
+            REWIND_SECS, DEFAULT_REWIND_MB);
+    fprintf(stderr, "  -R file   record the session's seed, level and input into file\n");
+    fprintf(stderr, "  -v        show frame size and encode time too\n");
+    fprintf(stderr, "  -P file   replay a recording without a terminal, as fast as possible,\n"
+                    "            checking it still plays out the same\n");
+}
+
+#ifndef TERRY_NO_MAIN // bench.c brings its own
+int main(int argc, char **argv) {
+    double fps = DEFAULT_FPS;
+    double tick_hz = DEFAULT_TICK_HZ;
+    bool random_start = false;
+    int threads = 0;
+    bool seeded = false;
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+    int rewind_mb = DEFAULT_REWIND_MB;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "sf:t:q:l:r:j:S:R:P:m:vh")) != -1) {
+        switch (opt) {
+        case 's':
+            set_renderer(RENDER_SEXTANT);
+            break;
+        case 'f':
+            fps = atof(optarg);
+            break;
+        case 't':
+            tick_hz = atof(optarg);
+            break;
+        case 'q':
+            output_state.outq_limit = atoi(optarg);
+            break;
+        case 'l':
+            level_file = optarg;
+            break;
+        case 'r':
+            if (sscanf(optarg, "%dx%d", &random_w, &random_h) != 2 ||
+                random_w < 3 || random_h < 3) {
+                usage(argv[0]);
+                return 1;
+            }
+            random_start = true;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            if (threads < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            seeded = true;
+            break;
+        case 'R':
+            record_file = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'P':
+            replay_file = optarg;
+            break;
+        case 'm':
+            rewind_mb = atoi(optarg);
+            if (rewind_mb < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (fps <= 0 || tick_hz <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (replay_file != NULL) {
+        return replay(replay_file, threads);
+    }
+
+    if (!seeded) {
+        seed = now_ns();
+    }
+    levels_rng = make_rng(seed, RNG_LEVELS);
+    fx_rng = make_rng(seed, RNG_FX);
+    init_rewind((size_t)rewind_mb << 20, REWIND_SECS * tick_hz + 1);
+    if (record_file != NULL && !start_recording(record_file)) {
+        fprintf(stderr, "Can't write %s\n", record_file);
+        return 1;
+    }
+    out = make_ansi_out(OUT_BUF_SIZE);
+    if (threads > 0) {
+        start_tick_pool(threads);
+    }
+
+    init_signals();
 
     cls();
     init();
-    resize();
+    out_flush(out, STDOUT_FILENO);
 
     ansi_keys *keys = make_ansi_keys();
+    term_margins = check_ansi_mode(69, keys);
 
-    player_state s;
-    reset(&s, false);
+    player_state s = {0};
+    reset(&s, random_start);
 
     bool running = true;
+    output_stats stats = {0};
+    char status[STATUS_LEN];
+
+    uint32_t size_gen = 1; // first frame: size up and paint the background
+    start_output();
+
+    uint64_t frame_ns = NS_PER_SEC / fps;
+    uint64_t next_frame = now_ns();
+    accumulator ticks = make_accumulator(tick_hz, next_frame);
+    accumulator fx = make_accumulator(FX_HZ, next_frame);
+    bool paused = false;
+    bool redraw = false;
+
+    // Everything wakes the one poll(): keys, signals, and the timer for the
+    // next frame/tick deadline. Nothing spins; paused means fully asleep.
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct pollfd fds[] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = sig_pipe[0], .events = POLLIN },
+        { .fd = timer, .events = POLLIN },
+    };
 
     while(running){
+        if (paused) {
+            set_timer_ns(timer, 0);
+        } else {
+            set_timer_ns(timer, min(next_frame, next_step_ns(&ticks)));
+        }
+        if (poll(fds, 3, -1) < 0 && errno != EINTR) break;
+
+        if (fds[1].revents & POLLIN) {
+            pending_signals sig = read_signals();
+            if (sig.quit) {
+                running = false;
+            }
+            if (sig.resized) {
+                size_gen++;
+                redraw = true;
+            }
+        }
+        if (fds[2].revents & POLLIN) {
+            uint64_t expirations;
+            read(timer, &expirations, sizeof(expirations));
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read_ansi_keys(keys);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                fds[0].fd = -1; // stdin closed or broken: stop polling it
+            }
+            redraw = true;
+        }
+
         s.dx = 0; // stop moving
         s.dy = 0;
         s.dig = false;
-
-        update_ansi_keys(keys);
         if (key_pressed('q', keys)) {
             running = false;
         }
@@ -1155,30 +3744,75 @@ int main() {
             key_unpress('e', keys);
             reset(&s, true);
         }
+        if (key_pressed('b', keys)) {
+            // a second back per press
+            key_unpress('b', keys);
+            rewind_to(&s, s.t - min(s.t, (uint32_t)tick_hz));
+            stream_sync(&s);
+            record_rewind(s.t);
+            snap_camera(&s);
+            redraw = true;
+        }
+        if (key_pressed('p', keys)) {
+            key_unpress('p', keys);
+            paused = !paused;
+            if (!paused) {
+                // don't try to catch up on the time spent paused
+                ticks.last = fx.last = next_frame = now_ns();
+                ticks.acc = fx.acc = 0;
+            }
+        }
         if (s.dx != 0) s.dy = 0;
 
-        // Update every 4 frames
-        if (++s.t % 4 == 0) {
-            tick_tiles(&s);
-            if (s.got_diamond) {
-                set_particles(s.x * px_per_tile + 1, s.y * px_per_tile + 1, 20);
+        uint64_t now = now_ns();
+        if (!paused) {
+            for (uint32_t n = accumulate(&ticks, now, MAX_CATCHUP_TICKS); n > 0; n--) {
+                uint8_t input = input_byte(&s);
+                s.t++;
+                tick_tiles(&s);
+                stream_tick(&s);
+                record_tick(&s, input);
+                rewind_tick(&s, false);
+                if (s.got_diamond) {
+                    set_particles(s.x * px_per_tile + 1, s.y * px_per_tile + 1, 20);
+                }
+            }
+            for (uint32_t n = accumulate(&fx, now, MAX_CATCHUP_TICKS); n > 0; n--) {
+                update_particles();
             }
         }
-        update_particles();
+
+        // Paused frames only get drawn when something asks for it
+        if (paused ? !redraw : now < next_frame) continue;
+        redraw = false;
+
         render_tiles_to_pixels(&s, false);
         render_particles(&s);
-        render_pixels();
 
-        set_bg(C_BLACK);
-        set_fg(C_WHITE);
-        cursor_to(scr_w / 2 - (PIX_W / 2), (scr_h / 2) + (PIX_H / 4) + 1);
-        printf("energy: %.2f %d | ", (float)s.cam_x / px_per_tile, s.x);
-        printf("move: wsad | r: restart | spc: 0=dig, 1=rock | cur: ");
-        printf(s.slot == 0 ? "shoot " : "dig  ");
+        // Keep it under 80 columns; frame stats go on a second line with -v
+        int len = snprintf(status, STATUS_LEN,
+                           "energy: %.2f %d | q: %dB drop: %u | r:restart b:back p:%s spc:%s",
+                           (float)s.cam_x / px_per_tile, s.x,
+                           stats.queued, stats.dropped + stats.skipped,
+                           paused ? "resume" : "pause ",
+                           s.slot == 0 ? "shoot" : "dig  ");
+        if (verbose && len > 0 && len < STATUS_LEN) {
+            snprintf(status + len, STATUS_LEN - len,
+                     "\nframe: %6zuB %5ldus ", stats.bytes, stats.encode_us);
+        }
+        stats = publish_frame(&s, size_gen, status);
 
-        fflush(stdout);
-        usleep(delay);
+        // Next deadline is absolute; if we're already late, don't try to
+        // make up for missed frames.
+        next_frame += frame_ns;
+        if (next_frame < now) next_frame = now + frame_ns;
     };
+    close(timer);
+    stop_output();
+    stop_tick_pool();
+    stop_streaming();
+    stop_recording();
     done(0);
     return 0;
 }
+#endif
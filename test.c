@@ -1,5 +1,19 @@
 #include <stdio.h>
 #include "./ansi_parse.h"
+#define TERRY_NO_MAIN
+#include "./terry.c"
+
+/// Tick a random world wide enough for four strips and hash it
+uint64_t random_run(uint32_t ticks) {
+    player_state s = { .x = 2, .y = 2, .lives = 16 };
+    init_world(512, 512, 1);
+    random_level(s.x, s.y);
+    for (uint32_t i = 0; i < ticks; i++) {
+        s.t++;
+        tick_tiles(&s);
+    }
+    return world_hash(&s);
+}
 
 int main() {
     ansi_state s = ansi_init();
@@ -14,5 +28,12 @@ int main() {
     ansi_step(&s, '3');
     ansi_res r = ansi_step(&s, 'u');
     printf("%d, %d %d %d %d.\n", s.state, r.done, r.key_code, r.modifier, r.key_event);
-    return 0;
+
+    // -j 4 has to play out exactly like one thread
+    uint64_t serial = random_run(100);
+    start_tick_pool(4);
+    uint64_t strips = random_run(100);
+    stop_tick_pool();
+    printf("serial %016" PRIx64 ", -j 4 %016" PRIx64 "\n", serial, strips);
+    return serial != strips;
 }